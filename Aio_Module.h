@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define AIO_HAVE_URING 1
+#endif
+#endif
+
+#define AIO_READ 0
+#define AIO_WRITE 1
+
+#define AIO_BACKEND_NONE 0      //Not chosen yet
+#define AIO_BACKEND_THREAD 1    //One pthread per request doing pread/pwrite
+#define AIO_BACKEND_URING 2
+
+#define AIO_URING_ENTRIES 8
+#define AIO_WRITER_BUFFER (256 * 1024)
+#define AIO_WRITER_LINE 1024    //Longest formatted piece, the buffer is sent before it gets this full
+
+//One read or write in flight. An offset of -1 uses and advances the file
+//position, which is what pipes and terminals need.
+typedef struct {
+    int op;
+    int fd;
+    void *buffer;
+    size_t size;
+    off_t offset;
+    ssize_t result;     //Bytes transferred or -errno
+    int pending;
+    int threaded;       //Running on its own thread, join before reading result
+    pthread_t thread;
+} AioRequest;
+
+//Double-buffered output: one buffer is filled while the other is written
+typedef struct {
+    int fd;
+    char *buffers[2];
+    size_t used;
+    int current;
+    AioRequest request;
+    int failed;
+} AioWriter;
+
+int aio_backend = AIO_BACKEND_NONE;
+
+#ifdef AIO_HAVE_URING
+//Submission and completion rings shared with the kernel
+int aio_ring_fd = -1;
+unsigned *aio_sq_head, *aio_sq_tail, *aio_sq_mask, *aio_sq_array;
+unsigned *aio_cq_head, *aio_cq_tail, *aio_cq_mask;
+struct io_uring_sqe *aio_sqes;
+struct io_uring_cqe *aio_cqes;
+#endif
+
+int aio_init();
+int aio_select(int backend);
+const char* aio_backend_name();
+void aio_submit(AioRequest *request, int op, int fd, void *buffer, size_t size, off_t offset);
+ssize_t aio_wait(AioRequest *request);
+void* aio_thread_main(void *arg);
+int aio_uring_init();
+int aio_uring_submit(AioRequest *request);
+void aio_uring_reap(int wait);
+int aio_writer_open(AioWriter *writer, int fd);
+void aio_writer_printf(AioWriter *writer, const char *format, ...);
+void aio_writer_write(AioWriter *writer, const char *data, size_t size);
+void aio_writer_flush(AioWriter *writer);
+int aio_writer_close(AioWriter *writer);
+
+int aio_init() {
+    //Pick io_uring when the kernel allows it, threads otherwise; return the backend
+    if (aio_backend == AIO_BACKEND_NONE) aio_select(AIO_BACKEND_URING);
+    return aio_backend;
+}
+
+int aio_select(int backend) {
+    //Switch backends between transfers, return 0 if io_uring was asked for but is unavailable
+#ifdef AIO_HAVE_URING
+    if (backend == AIO_BACKEND_URING && (aio_ring_fd >= 0 || aio_uring_init())) {
+        aio_backend = AIO_BACKEND_URING;
+        return 1;
+    }
+#endif
+    aio_backend = AIO_BACKEND_THREAD;
+    return backend == AIO_BACKEND_THREAD;
+}
+
+const char* aio_backend_name() {
+    switch (aio_init()) {
+        case AIO_BACKEND_URING: return "io_uring";
+        default: return "threads";
+    }
+}
+
+void aio_submit(AioRequest *request, int op, int fd, void *buffer, size_t size, off_t offset) {
+    //Start a transfer; buffer must stay untouched until aio_wait returns
+    memset(request, 0, sizeof(AioRequest));
+    request->op = op;
+    request->fd = fd;
+    request->buffer = buffer;
+    request->size = size;
+    request->offset = offset;
+    request->pending = 1;
+
+#ifdef AIO_HAVE_URING
+    if (aio_init() == AIO_BACKEND_URING && aio_uring_submit(request)) return;
+#else
+    aio_init();
+#endif
+    if (pthread_create(&request->thread, NULL, aio_thread_main, request) == 0) {
+        request->threaded = 1;
+        return;
+    }
+    //No thread either, do the transfer now
+    aio_thread_main(request);
+}
+
+ssize_t aio_wait(AioRequest *request) {
+    //Wait for a submitted transfer, return bytes transferred or -errno
+    if (request->threaded) {
+        pthread_join(request->thread, NULL);
+        request->threaded = 0;
+    }
+#ifdef AIO_HAVE_URING
+    while (request->pending) aio_uring_reap(1);
+#endif
+    return request->result;
+}
+
+void* aio_thread_main(void *arg) {
+    AioRequest *request = (AioRequest*)arg;
+    ssize_t done;
+    if (request->op == AIO_READ) {
+        done = request->offset < 0 ? read(request->fd, request->buffer, request->size)
+                                   : pread(request->fd, request->buffer, request->size, request->offset);
+    } else {
+        done = request->offset < 0 ? write(request->fd, request->buffer, request->size)
+                                   : pwrite(request->fd, request->buffer, request->size, request->offset);
+    }
+    request->result = done < 0 ? -errno : done;
+    request->pending = 0;
+    return NULL;
+}
+
+#ifdef AIO_HAVE_URING
+int aio_uring_init() {
+    //Set up a small ring through the raw syscalls, return 0 if io_uring is unavailable
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(SYS_io_uring_setup, AIO_URING_ENTRIES, &params);
+    if (fd < 0) return 0;
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    char *sq = (char*)mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    char *cq = (char*)mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void *sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+        if (sq != MAP_FAILED) munmap(sq, sq_size);
+        if (cq != MAP_FAILED) munmap(cq, cq_size);
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        close(fd);
+        return 0;
+    }
+
+    aio_ring_fd = fd;
+    aio_sq_head = (unsigned*)(sq + params.sq_off.head);
+    aio_sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    aio_sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    aio_sq_array = (unsigned*)(sq + params.sq_off.array);
+    aio_cq_head = (unsigned*)(cq + params.cq_off.head);
+    aio_cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    aio_cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    aio_cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    aio_sqes = (struct io_uring_sqe*)sqes;
+    return 1;
+}
+
+int aio_uring_submit(AioRequest *request) {
+    //Queue one READ or WRITE entry and tell the kernel, return 0 to fall back
+    unsigned tail = *aio_sq_tail;
+    if (tail - __atomic_load_n(aio_sq_head, __ATOMIC_ACQUIRE) > *aio_sq_mask) return 0;
+    unsigned index = tail & *aio_sq_mask;
+    struct io_uring_sqe *sqe = &aio_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request->op == AIO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = request->fd;
+    sqe->addr = (uint64_t)(uintptr_t)request->buffer;
+    sqe->len = request->size > 0x7FFFF000 ? 0x7FFFF000 : (unsigned)request->size;
+    sqe->off = (uint64_t)(int64_t)request->offset;     //-1 is the file position
+    sqe->user_data = (uint64_t)(uintptr_t)request;
+    aio_sq_array[index] = index;
+    __atomic_store_n(aio_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    if (syscall(SYS_io_uring_enter, aio_ring_fd, 1, 0, 0, NULL, 0) < 0) {
+        //Take the entry back; the kernel has not consumed it
+        __atomic_store_n(aio_sq_tail, tail, __ATOMIC_RELEASE);
+        return 0;
+    }
+    return 1;
+}
+
+void aio_uring_reap(int wait) {
+    //Hand every completion to its request, sleeping for one first if asked
+    unsigned head = *aio_cq_head;
+    if (wait && head == __atomic_load_n(aio_cq_tail, __ATOMIC_ACQUIRE)) {
+        syscall(SYS_io_uring_enter, aio_ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    }
+    while (head != __atomic_load_n(aio_cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &aio_cqes[head & *aio_cq_mask];
+        AioRequest *request = (AioRequest*)(uintptr_t)cqe->user_data;
+        request->result = cqe->res;
+        request->pending = 0;
+        head++;
+    }
+    __atomic_store_n(aio_cq_head, head, __ATOMIC_RELEASE);
+}
+#else
+int aio_uring_init() {
+    return 0;
+}
+#endif
+
+int aio_writer_open(AioWriter *writer, int fd) {
+    //Without buffers every piece is written directly, return 0 in that case
+    memset(writer, 0, sizeof(AioWriter));
+    writer->fd = fd;
+    writer->buffers[0] = (char*)malloc(AIO_WRITER_BUFFER);
+    writer->buffers[1] = (char*)malloc(AIO_WRITER_BUFFER);
+    if (!writer->buffers[0] || !writer->buffers[1]) {
+        free(writer->buffers[0]);
+        free(writer->buffers[1]);
+        writer->buffers[0] = writer->buffers[1] = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void aio_writer_printf(AioWriter *writer, const char *format, ...) {
+    va_list args, again;
+    va_start(args, format);
+    if (!writer->buffers[0]) {
+        vdprintf(writer->fd, format, args);
+        va_end(args);
+        return;
+    }
+    va_copy(again, args);
+    size_t space = AIO_WRITER_BUFFER - writer->used;
+    int length = vsnprintf(writer->buffers[writer->current] + writer->used, space, format, args);
+    va_end(args);
+    if (length >= 0 && (size_t)length < space) {
+        writer->used += length;
+    } else if (length > 0) {
+        //Longer than the space left: format the piece on its own and copy it in parts
+        char *piece = (char*)malloc((size_t)length + 1);
+        if (piece) {
+            vsnprintf(piece, (size_t)length + 1, format, again);
+            aio_writer_write(writer, piece, length);
+            free(piece);
+        } else {
+            writer->failed = 1;
+        }
+    }
+    va_end(again);
+    if (AIO_WRITER_BUFFER - writer->used < AIO_WRITER_LINE) aio_writer_flush(writer);
+}
+
+void aio_writer_write(AioWriter *writer, const char *data, size_t size) {
+    //Copy size bytes in, sending every buffer that fills up
+    if (!writer->buffers[0]) {
+        if (write(writer->fd, data, size) != (ssize_t)size) writer->failed = 1;
+        return;
+    }
+    while (size > 0) {
+        size_t chunk = AIO_WRITER_BUFFER - writer->used;
+        if (chunk > size) chunk = size;
+        memcpy(writer->buffers[writer->current] + writer->used, data, chunk);
+        writer->used += chunk;
+        data += chunk;
+        size -= chunk;
+        if (writer->used == AIO_WRITER_BUFFER) aio_writer_flush(writer);
+    }
+}
+
+void aio_writer_flush(AioWriter *writer) {
+    //Wait for the previous buffer to be written out completely, then send the
+    //filled one and keep formatting into the other
+    if (!writer->buffers[0]) return;
+    AioRequest *request = &writer->request;
+    while (request->pending || request->threaded) {
+        ssize_t done = aio_wait(request);
+        if (done <= 0) {
+            if (done != -EINTR && done != -EAGAIN) writer->failed = 1;
+            if (!writer->failed) aio_submit(request, AIO_WRITE, writer->fd, request->buffer, request->size, -1);
+            continue;
+        }
+        if ((size_t)done < request->size) {
+            //Short write to a pipe, send the rest
+            aio_submit(request, AIO_WRITE, writer->fd, (char*)request->buffer + done, request->size - done, -1);
+        }
+    }
+    if (writer->used == 0 || writer->failed) {
+        writer->used = 0;
+        return;
+    }
+    aio_submit(request, AIO_WRITE, writer->fd, writer->buffers[writer->current], writer->used, -1);
+    writer->current = !writer->current;
+    writer->used = 0;
+}
+
+int aio_writer_close(AioWriter *writer) {
+    //Send what is left and wait for it, return 0 if any write failed
+    aio_writer_flush(writer);
+    aio_writer_flush(writer);
+    free(writer->buffers[0]);
+    free(writer->buffers[1]);
+    writer->buffers[0] = writer->buffers[1] = NULL;
+    return !writer->failed;
+}
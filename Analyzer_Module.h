@@ -1,72 +1,257 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include "node.h"
 
-#define MAX_BATTERIES 3
-#define MAX_CABLES 3
-#define MAX_LOCKERS 3
-#define MAX_UMBRELLAS 3
-#define MAX_VALETS 3
-#define MAX_INFLATIONS 3
-#define TESTING_DAY 7
-#define TIME_SLOT_PER_DAY 24
-
-void gen_report(FILE* report, Node* booking, Node* accepted, Node* rejected, int invalid_requests);
-void count_resources(Node* head, int* battery, int* cable, int* locker, int* umbrella, int* valet, int* inflation);
-void count_max_resources(int* battery, int* cable, int* locker, int* umbrella, int* valet, int* inflation);
-int list_length(Node* list);
-
-void gen_report(FILE* report, Node* booking, Node* accepted, Node* rejected, int invalid_requests) {
-    int booking_num = list_length(booking);
-    int request_num = booking_num + invalid_requests;
-    int battery, cable, locker, umbrella, valet, inflation, max_battery, max_cable, max_locker, max_umbrella, max_valet, max_inflation;
-    count_resources(accepted, &battery, &cable, &locker, &umbrella, &valet, &inflation);
-    count_max_resources(&max_battery, &max_cable, &max_locker, &max_umbrella, &max_valet, &max_inflation);
-
-    fprintf(report, " \t\tTotal Number of Bookings Received: %d (%.1f%%)\n", booking_num, (float)booking_num/request_num*100);
-    fprintf(report, " \t\t\t  Number of Bookings Assigned: %d (%.1f%%)\n", list_length(accepted),(float)list_length(accepted)/booking_num*100);
-    fprintf(report, " \t\t\t  Number of Bookings Rejected: %d (%.1f%%)\n",list_length(rejected) ,(float)list_length(rejected)/booking_num*100);
-    fprintf(report, " \t\tUtilization of Time Slot:\n");
-    fprintf(report, " \t\t\t Battery   - %.1f%%\n", (float)battery/max_battery*100);
-    fprintf(report, " \t\t\t Cable     - %.1f%%\n", (float)cable/max_cable*100);
-    fprintf(report, " \t\t\t Locker    - %.1f%%\n", (float)locker/max_locker*100);
-    fprintf(report, " \t\t\t Umbrella  - %.1f%%\n", (float)umbrella/max_umbrella*100);
-    fprintf(report, " \t\t\t Valet     - %.1f%%\n", (float)valet/max_valet*100);
-    fprintf(report, " \t\t\t Inflation - %.1f%%\n", (float)inflation/max_inflation*100);
-    fprintf(report, "\n \t\tInvalid request(s) made: %d\n", invalid_requests);
+#define SLOTS_PER_HOUR (60/SLOT_MINUTES)
+#define HORIZON_SLOTS (TESTING_DAY*TIME_SLOT_PER_DAY)
+#define HEATMAP_MAGIC "PBHM"
+#define HEATMAP_VERSION 1
+
+//Bit r of a packed resource mask is set when the booking uses resource r of the catalog
+typedef struct {
+    int booking_num;
+    int accepted_num;
+    int rejected_num;
+    int resource_slots[RESOURCE_NUM];                   //Booked slots per resource
+    int day_slots[RESOURCE_NUM][TESTING_DAY];           //Booked slots per resource per day
+    int hour_slots[RESOURCE_NUM][24];                   //Booked slots per resource per hour of day
+    int member_num;
+    int* member_slots;                                  //Resource-slots per member id
+} Analytics;
+
+extern int resource_capacity[RESOURCE_NUM];
+int date_to_day_index(const char* date);
+int time_to_slot(const char* time);
+int duration_to_slots(float duration);
+void gen_report(AioWriter* report, const ScheduleTotals* totals, Node* accepted);
+void gen_breakdown_report(AioWriter* report, const Analytics* analytics);
+int analyze_bookings(const ScheduleTotals* totals, Node* accepted, Analytics* analytics);
+void free_analytics(Analytics* analytics);
+unsigned int resource_mask(const Booking* booking);
+void resource_counts(const Booking* booking, int counts[RESOURCE_NUM]);
+void gen_heatmap_summary(AioWriter* report, int occupancy[][TESTING_DAY][TIME_SLOT_PER_DAY]);
+int export_heatmap_csv(const char* filename, int occupancy[][TESTING_DAY][TIME_SLOT_PER_DAY]);
+int export_heatmap_binary(const char* filename, int occupancy[][TESTING_DAY][TIME_SLOT_PER_DAY]);
+int put_uint16_le(unsigned char* data, int offset, int value);
+void gen_heatmap_summary(AioWriter* report, int occupancy[][TESTING_DAY][TIME_SLOT_PER_DAY]) {
+    //Print peak slot, busiest time of day and idle slots of every resource
+    int r, day, slot;
+    for (r = 0; r < resource_count; r++) {
+        int peak = -1, peak_day = 0, peak_slot = 0, idle = 0;
+        int slot_total[TIME_SLOT_PER_DAY] = {0};
+        for (day = 0; day < TESTING_DAY; day++) {
+            for (slot = 0; slot < TIME_SLOT_PER_DAY; slot++) {
+                int used = occupancy[r][day][slot];
+                if (used > peak) {
+                    peak = used;
+                    peak_day = day;
+                    peak_slot = slot;
+                }
+                if (used == 0) idle++;
+                slot_total[slot] += used;
+            }
+        }
+        int busiest = 0;
+        for (slot = 1; slot < TIME_SLOT_PER_DAY; slot++) {
+            if (slot_total[slot] > slot_total[busiest]) busiest = slot;
+        }
+        aio_writer_printf(report, " \t\t %-10s peak %d/%d on Day %d %02d:%02d, busiest slot %02d:%02d, %d/%d idle slot(s)\n",
+                resource_catalog[r].title, peak, resource_capacity[r], peak_day + 1,
+                peak_slot * SLOT_MINUTES / 60, peak_slot * SLOT_MINUTES % 60,
+                busiest * SLOT_MINUTES / 60, busiest * SLOT_MINUTES % 60, idle, HORIZON_SLOTS);
+    }
+}
+
+int export_heatmap_csv(const char* filename, int occupancy[][TESTING_DAY][TIME_SLOT_PER_DAY]) {
+    //One row per resource, day and time slot
+    FILE* file = fopen(filename, "w");
+    if (!file) return 0;
+    fprintf(file, "resource,day,time,occupied,capacity\n");
+    int r, day, slot;
+    for (r = 0; r < resource_count; r++) {
+        for (day = 0; day < TESTING_DAY; day++) {
+            for (slot = 0; slot < TIME_SLOT_PER_DAY; slot++) {
+                fprintf(file, "%s,%d,%02d:%02d,%d,%d\n", resource_catalog[r].title, day + 1,
+                        slot * SLOT_MINUTES / 60, slot * SLOT_MINUTES % 60, occupancy[r][day][slot], resource_capacity[r]);
+            }
+        }
+    }
+    return fclose(file) == 0;
 }
 
-void count_resources(Node* head, int* battery, int* cable, int* locker, int* umbrella, int* valet, int* inflation) {
-    //Count resources total duration in accepted
-    *battery = *cable = *locker = *umbrella = *valet = *inflation = 0;
-    Node* current = head;
-    while (current != NULL) {
-        if (current->booking.battery) (*battery) += current->booking.duration;
-        if (current->booking.cable) (*cable) += current->booking.duration;
-        if (current->booking.locker) (*locker) += current->booking.duration;
-        if (current->booking.umbrella) (*umbrella) += current->booking.duration;
-        if (current->booking.valet) (*valet) += current->booking.duration;
-        if (current->booking.inflation) (*inflation) += current->booking.duration;
-        current = current->next;
+int export_heatmap_binary(const char* filename, int occupancy[][TESTING_DAY][TIME_SLOT_PER_DAY]) {
+    //Layout: magic, version, resource/day/slot counts, capacities, then
+    //occupancy[resource][day][slot], all as little-endian uint16 whatever the host order
+    unsigned char data[4 + (4 + RESOURCE_NUM + RESOURCE_NUM * HORIZON_SLOTS) * 2];
+    int length = 4;
+    memcpy(data, HEATMAP_MAGIC, 4);
+    length = put_uint16_le(data, length, HEATMAP_VERSION);
+    length = put_uint16_le(data, length, resource_count);
+    length = put_uint16_le(data, length, TESTING_DAY);
+    length = put_uint16_le(data, length, TIME_SLOT_PER_DAY);
+    int r, i;
+    for (r = 0; r < resource_count; r++) length = put_uint16_le(data, length, resource_capacity[r]);
+    for (r = 0; r < resource_count; r++) {
+        for (i = 0; i < HORIZON_SLOTS; i++) {
+            length = put_uint16_le(data, length, occupancy[r][i / TIME_SLOT_PER_DAY][i % TIME_SLOT_PER_DAY]);
+        }
     }
+    FILE* file = fopen(filename, "wb");
+    if (!file) return 0;
+    int ok = fwrite(data, length, 1, file) == 1;
+    return (fclose(file) == 0) && ok;
 }
 
-void count_max_resources(int* battery, int* cable, int* locker, int* umbrella, int* valet, int* inflation) {
-    //Count resources total time slot
-    *battery = MAX_BATTERIES*TESTING_DAY*TIME_SLOT_PER_DAY;
-    *cable = MAX_CABLES*TESTING_DAY*TIME_SLOT_PER_DAY;
-    *locker = MAX_LOCKERS*TESTING_DAY*TIME_SLOT_PER_DAY;
-    *umbrella = MAX_UMBRELLAS*TESTING_DAY*TIME_SLOT_PER_DAY;
-    *valet = MAX_VALETS*TESTING_DAY*TIME_SLOT_PER_DAY;
-    *inflation = MAX_INFLATIONS*TESTING_DAY*TIME_SLOT_PER_DAY;
+int put_uint16_le(unsigned char* data, int offset, int value) {
+    //Store the low 16 bits of value at offset, low byte first; return the next offset
+    data[offset] = value & 0xFF;
+    data[offset + 1] = (value >> 8) & 0xFF;
+    return offset + 2;
+}
+
+void gen_report(AioWriter* report, const ScheduleTotals* totals, Node* accepted) {
+    Analytics analytics;
+    int invalid_requests = totals->invalid_num;
+    if (!analyze_bookings(totals, accepted, &analytics)) {
+        aio_writer_printf(report, " \t\tReport unavailable: memory allocation failed.\n");
+        return;
+    }
+    int booking_num = analytics.booking_num;
+    int request_num = booking_num + invalid_requests;
+
+    aio_writer_printf(report, " \t\tTotal Number of Bookings Received: %d (%.1f%%)\n", booking_num, (float)booking_num/request_num*100);
+    aio_writer_printf(report, " \t\t\t  Number of Bookings Assigned: %d (%.1f%%)\n", analytics.accepted_num,(float)analytics.accepted_num/booking_num*100);
+    aio_writer_printf(report, " \t\t\t  Number of Bookings Rejected: %d (%.1f%%)\n", analytics.rejected_num,(float)analytics.rejected_num/booking_num*100);
+    aio_writer_printf(report, " \t\tUtilization of Time Slot:\n");
+    int r;
+    for (r = SPACE + 1; r < resource_count; r++) {
+        //Share of every unit slot of the testing period
+        int max_slots = resource_capacity[r]*TESTING_DAY*TIME_SLOT_PER_DAY;
+        aio_writer_printf(report, " \t\t\t %-10s- %.1f%%\n", resource_catalog[r].title, (float)analytics.resource_slots[r]/max_slots*100);
+    }
+    aio_writer_printf(report, "\n \t\tInvalid request(s) made: %d\n", invalid_requests);
+
+    free_analytics(&analytics);
+}
+
+void gen_breakdown_report(AioWriter* report, const Analytics* analytics) {
+    //Print per-day, per-hour and per-member utilization from one analytics pass
+    int r, day, hour, member;
+
+    aio_writer_printf(report, " \t\tUtilization per Day:\n \t\t\t %-10s", "");
+    for (day = 0; day < TESTING_DAY; day++) aio_writer_printf(report, "  Day %-3d", day + 1);
+    aio_writer_printf(report, "\n");
+    for (r = 0; r < resource_count; r++) {
+        aio_writer_printf(report, " \t\t\t %-10s", resource_catalog[r].title);
+        for (day = 0; day < TESTING_DAY; day++) {
+            aio_writer_printf(report, " %6.1f%%", (float)analytics->day_slots[r][day]/(resource_capacity[r]*TIME_SLOT_PER_DAY)*100);
+        }
+        aio_writer_printf(report, "\n");
+    }
+
+    aio_writer_printf(report, " \t\tUtilization per Hour of Day:\n \t\t\t %-10s", "");
+    for (hour = 0; hour < 24; hour++) aio_writer_printf(report, " %3d", hour);
+    aio_writer_printf(report, "\n");
+    for (r = 0; r < resource_count; r++) {
+        aio_writer_printf(report, " \t\t\t %-10s", resource_catalog[r].title);
+        for (hour = 0; hour < 24; hour++) {
+            aio_writer_printf(report, " %3.0f", (float)analytics->hour_slots[r][hour]/(resource_capacity[r]*TESTING_DAY*SLOTS_PER_HOUR)*100);
+        }
+        aio_writer_printf(report, "\n");
+    }
+
+    aio_writer_printf(report, " \t\tResource-Hours per Member:\n");
+    for (member = 0; member < analytics->member_num; member++) {
+        if (analytics->member_slots[member] == 0) continue;
+        aio_writer_printf(report, " \t\t\t %-20s %g\n", member_name(member), (float)analytics->member_slots[member] / SLOTS_PER_HOUR);
+    }
 }
 
-int list_length(Node* list) {
-    //Count the length of linkedlist
-    int count = 0;
-    Node* current = list;
-    while (current != NULL) {
-        count++;
-        current = current->next;
+int analyze_bookings(const ScheduleTotals* totals, Node* accepted, Analytics* analytics) {
+    //Pack accepted bookings into columns in one walk of the list, sized by the
+    //counts of the scheduling run, then reduce every statistic in one loop
+    memset(analytics, 0, sizeof(Analytics));
+    analytics->booking_num = totals->booking_num;
+    analytics->rejected_num = totals->rejected_num;
+
+    int n = totals->accepted_num;
+    int (*units)[RESOURCE_NUM] = malloc((n + 1) * sizeof(*units));
+    int* duration = (int*)malloc((n + 1) * sizeof(int));
+    int* start = (int*)malloc((n + 1) * sizeof(int));
+    int* member = (int*)malloc((n + 1) * sizeof(int));
+    int (*diff)[HORIZON_SLOTS + 1] = calloc(RESOURCE_NUM, sizeof(*diff));
+    if (!units || !duration || !start || !member || !diff) {
+        free(units); free(duration); free(start); free(member); free(diff);
+        return 0;
+    }
+
+    int i, r, member_num = 0;
+    Node* current = accepted;
+    for (i = 0; i < n && current != NULL; i++, current = current->next) {
+        const Booking* b = &current->booking;
+        resource_counts(b, units[i]);
+        duration[i] = duration_to_slots(b->duration);
+        start[i] = date_to_day_index(b->date) * TIME_SLOT_PER_DAY + time_to_slot(b->time);
+        member[i] = b->member_id;
+        if (b->member_id + 1 > member_num) member_num = b->member_id + 1;
+    }
+    n = i;
+    analytics->accepted_num = n;
+    analytics->member_num = member_num;
+    analytics->member_slots = (int*)calloc(member_num + 1, sizeof(int));
+    if (!analytics->member_slots) {
+        free(units); free(duration); free(start); free(member); free(diff);
+        return 0;
     }
-    return count;
-}
\ No newline at end of file
+
+    //Branch-free reduction: every resource contributes units*duration, and the
+    //booked slot range is recorded in a difference array for the time breakdowns
+    for (i = 0; i < n; i++) {
+        int d = duration[i];
+        int total = 0;
+        int first = start[i] < 0 ? 0 : start[i];
+        int last = start[i] + d;
+        first = first > HORIZON_SLOTS ? HORIZON_SLOTS : first;
+        last = last > HORIZON_SLOTS ? HORIZON_SLOTS : (last < first ? first : last);
+        for (r = 0; r < RESOURCE_NUM; r++) {
+            int count = units[i][r];
+            analytics->resource_slots[r] += count * d;
+            diff[r][first] += count;
+            diff[r][last] -= count;
+            total += count;
+        }
+        analytics->member_slots[member[i] < 0 ? member_num : member[i]] += total * d;
+    }
+
+    //Prefix sums turn the difference arrays into per-slot occupancy
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        int occupied = 0, slot;
+        for (slot = 0; slot < HORIZON_SLOTS; slot++) {
+            occupied += diff[r][slot];
+            analytics->day_slots[r][slot / TIME_SLOT_PER_DAY] += occupied;
+            analytics->hour_slots[r][slot % TIME_SLOT_PER_DAY / SLOTS_PER_HOUR] += occupied;
+        }
+    }
+
+    free(units); free(duration); free(start); free(member); free(diff);
+    return 1;
+}
+
+void free_analytics(Analytics* analytics) {
+    free(analytics->member_slots);
+    analytics->member_slots = NULL;
+}
+
+unsigned int resource_mask(const Booking* booking) {
+    //Requested resources, without any the loaded catalog does not define
+    return booking->resources & ((1u << resource_count) - 1);
+}
+
+void resource_counts(const Booking* booking, int counts[RESOURCE_NUM]) {
+    //Units requested of every resource, more than one only for group events
+    unsigned int mask = resource_mask(booking);
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) counts[r] = mask >> r & 1 ? booking->quantity[r] : 0;
+}
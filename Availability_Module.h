@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "node.h"
+
+//Free capacity over slot ranges. Units in use per slot are kept in one max
+//segment tree per resource, so the fewest free units of a range are found in
+//O(log slots) whatever the number of bookings. The trees are rebuilt from a
+//SlotIndex only after the booking store or the live index changed.
+int availability_leaves = 0;            //Power of two >= SLOT_HORIZON
+int *availability_tree[RESOURCE_NUM];   //Node i covers the leaves below it, leaves start at availability_leaves
+int availability_capacity[RESOURCE_NUM];
+int availability_valid = 0;
+
+int availability_build(const SlotIndex *index);
+void availability_invalidate();
+int availability_query(int first, int last, int free_units[RESOURCE_NUM]);
+
+int availability_build(const SlotIndex *index) {
+    //Count the units in use per slot and build every tree, return 0 on failure
+    int r;
+    if (availability_leaves == 0) {
+        int leaves = 1;
+        while (leaves < SLOT_HORIZON) leaves *= 2;
+        for (r = 0; r < RESOURCE_NUM; r++) {
+            availability_tree[r] = (int*)malloc(2 * leaves * sizeof(int));
+            if (!availability_tree[r]) {
+                while (r-- > 0) free(availability_tree[r]);
+                return 0;
+            }
+        }
+        availability_leaves = leaves;
+    }
+
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        int *tree = availability_tree[r];
+        int *used = tree + availability_leaves;
+        memset(used, 0, availability_leaves * sizeof(int));
+        int unit, word;
+        for (unit = 0; unit < index->capacity[r]; unit++) {
+            SlotWord *words = slot_unit(index, r, unit);
+            for (word = 0; word < SLOT_WORDS_PER_UNIT; word++) {
+                uint64_t bits = atomic_load_explicit(&words[word], memory_order_relaxed);
+                while (bits) {
+                    used[word * 64 + __builtin_ctzll(bits)]++;
+                    bits &= bits - 1;
+                }
+            }
+        }
+        int i;
+        for (i = availability_leaves - 1; i >= 1; i--) {
+            tree[i] = tree[2 * i] > tree[2 * i + 1] ? tree[2 * i] : tree[2 * i + 1];
+        }
+        availability_capacity[r] = index->capacity[r];
+    }
+    availability_valid = 1;
+    return 1;
+}
+
+void availability_invalidate() {
+    availability_valid = 0;
+}
+
+int availability_query(int first, int last, int free_units[RESOURCE_NUM]) {
+    //Fewest free units of every resource over the inclusive slots [first, last]
+    if (!availability_valid || first < 0 || last >= SLOT_HORIZON || first > last) return 0;
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        const int *tree = availability_tree[r];
+        int peak = 0;
+        int low = first + availability_leaves, high = last + availability_leaves + 1;
+        while (low < high) {
+            if (low & 1) {
+                if (tree[low] > peak) peak = tree[low];
+                low++;
+            }
+            if (high & 1) {
+                high--;
+                if (tree[high] > peak) peak = tree[high];
+            }
+            low /= 2;
+            high /= 2;
+        }
+        free_units[r] = availability_capacity[r] - peak;
+    }
+    return 1;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "node.h"
+
+#define MAX_PARKING_SPACES 10
+#define MAX_BATTERIES 3
+#define MAX_CABLES 3
+#define MAX_LOCKERS 3
+#define MAX_UMBRELLAS 3
+#define MAX_VALETS 3
+#define MAX_INFLATIONS 3
+#define CATALOG_FILE "resources.dat"
+#define CATALOG_NAME_LEN 32
+#define SPACE 0     //The first resource of every catalog is the parking space
+
+//Resource types a site lends out, read from the catalog file at startup or
+//taken from the built-in list. Resource r is bit r of a booking's resource
+//mask, so the schedulers and reports loop over the catalog instead of naming
+//each resource. Only addParking, addReservation and addEvent book the space.
+typedef struct {
+    char key[CATALOG_NAME_LEN];         //Spelling in booking commands
+    char name[CATALOG_NAME_LEN];        //Short name of booking rows
+    char title[CATALOG_NAME_LEN];       //Name in reports, the short name capitalized
+    char label[CATALOG_NAME_LEN];       //Name in the booking list
+    int capacity;                       //Units of a site that does not set its own
+    char bundle_keys[CATALOG_NAME_LEN * 2];
+    unsigned int bundle;                //Resources addParking and addReservation book along with this one
+} CatalogEntry;
+
+CatalogEntry resource_catalog[RESOURCE_NUM];
+int resource_count = 0;
+
+int catalog_add(const char *key, const char *name, int capacity, const char *bundle, const char *label);
+int catalog_load(const char *filename);
+void catalog_defaults();
+void catalog_link();
+int catalog_lookup(const char *key, int length);
+int catalog_find(const char *name);
+void catalog_capacities(int capacity[RESOURCE_NUM]);
+void booking_request(Booking *booking, int resource, int count);
+
+int catalog_add(const char *key, const char *name, int capacity, const char *bundle, const char *label) {
+    //Append one resource type, return its index or -1. Bundles are resolved
+    //by catalog_link once every type is known.
+    if (resource_count == RESOURCE_NUM || capacity < 0) return -1;
+    if (strlen(key) == 0 || strlen(key) >= CATALOG_NAME_LEN || strlen(name) >= CATALOG_NAME_LEN ||
+        strlen(label) >= CATALOG_NAME_LEN || strlen(bundle) >= CATALOG_NAME_LEN * 2) return -1;
+    if (catalog_lookup(key, strlen(key)) >= 0) return -1;
+
+    CatalogEntry *entry = &resource_catalog[resource_count];
+    memset(entry, 0, sizeof(CatalogEntry));
+    strcpy(entry->key, key);
+    strcpy(entry->name, name);
+    strcpy(entry->title, name);
+    entry->title[0] = toupper((unsigned char)entry->title[0]);
+    strcpy(entry->label, label);
+    entry->capacity = capacity;
+    if (strcmp(bundle, "-") != 0) strcpy(entry->bundle_keys, bundle);
+    return resource_count++;
+}
+
+int catalog_load(const char *filename) {
+    //One resource per line: key, short name, capacity, bundle ('+' between
+    //keys, '-' for none) and the rest of the line as label. The first line
+    //is the parking space. Return resources loaded, or -1 with no catalog set.
+    FILE *file = fopen(filename, "r");
+    if (!file) return -1;
+
+    char line[256];
+    resource_count = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *key = strtok(line, " \t\r\n");
+        if (key == NULL || key[0] == '#') continue;
+        char *name = strtok(NULL, " \t\r\n");
+        char *capacity = strtok(NULL, " \t\r\n");
+        char *bundle = strtok(NULL, " \t\r\n");
+        char *label = strtok(NULL, "\r\n");
+        if (label) label += strspn(label, " \t");
+        if (!label || !*label || catalog_add(key, name, atoi(capacity), bundle, label) < 0) {
+            printf("-> Resource %s of %s not recognized.\n", key, filename);
+            resource_count = 0;
+            break;
+        }
+    }
+    fclose(file);
+    if (resource_count == 0) return -1;
+    catalog_link();
+    return resource_count;
+}
+
+void catalog_defaults() {
+    //The resources the booking commands were written for
+    resource_count = 0;
+    catalog_add("space", "space", MAX_PARKING_SPACES, "-", "Space");
+    catalog_add("battery", "battery", MAX_BATTERIES, "cable", "Battery");
+    catalog_add("cable", "cable", MAX_CABLES, "battery", "Cable");
+    catalog_add("locker", "locker", MAX_LOCKERS, "umbrella", "Locker");
+    catalog_add("umbrella", "umbrella", MAX_UMBRELLAS, "locker", "Umbrella");
+    catalog_add("valetPark", "valet", MAX_VALETS, "InflationService", "Valet Park");
+    catalog_add("InflationService", "inflation", MAX_INFLATIONS, "valetPark", "Inflation Service");
+    catalog_link();
+}
+
+void catalog_link() {
+    //Turn the bundle keys of every resource into a mask
+    int r;
+    for (r = 0; r < resource_count; r++) {
+        CatalogEntry *entry = &resource_catalog[r];
+        const char *p = entry->bundle_keys;
+        entry->bundle = 0;
+        while (*p) {
+            int length = strcspn(p, "+");
+            int other = catalog_lookup(p, length);
+            if (other > SPACE) entry->bundle |= 1u << other;
+            else printf("-> Bundle of %s: resource %.*s not recognized.\n", entry->key, length, p);
+            p += length;
+            if (*p == '+') p++;
+        }
+    }
+}
+
+int catalog_lookup(const char *key, int length) {
+    //Resource whose command spelling is the first length chars of key, or -1
+    int r;
+    for (r = 0; r < resource_count; r++) {
+        if ((int)strlen(resource_catalog[r].key) == length && strncmp(resource_catalog[r].key, key, length) == 0) return r;
+    }
+    return -1;
+}
+
+int catalog_find(const char *name) {
+    //Resource named by its key or short name in any case, or -1
+    int r;
+    for (r = 0; r < resource_count; r++) {
+        if (strcasecmp(name, resource_catalog[r].key) == 0 || strcasecmp(name, resource_catalog[r].name) == 0) return r;
+    }
+    return -1;
+}
+
+void catalog_capacities(int capacity[RESOURCE_NUM]) {
+    //Default capacities, 0 past the end of the catalog
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) capacity[r] = r < resource_count ? resource_catalog[r].capacity : 0;
+}
+
+void booking_request(Booking *booking, int resource, int count) {
+    //Ask for count units of resource, keeping the larger of two requests
+    if (resource < 0 || resource >= resource_count || count <= 0) return;
+    booking->resources |= 1u << resource;
+    if (count > booking->quantity[resource]) booking->quantity[resource] = count;
+}
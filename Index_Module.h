@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "node.h"
+
+//Booking ids are handed out densely, so the id index is a plain array with
+//one entry per id ever issued. An entry also remembers the node before the
+//booking in its site's store list, which lets a cancellation unlink the node
+//from the singly linked store without walking it.
+typedef struct {
+    Node *node;                 //NULL when the id is free or cancelled
+    Node *prev;                 //Previous node of the same store list, NULL at the head
+    SlotUnits units;            //Units held in the live slot index, none if unit[r] is -1
+} BookingEntry;
+
+BookingEntry *booking_entries = NULL;
+int booking_entry_allocated = 0;
+int booking_next_id = 1;
+
+//Secondary indexes file every booking id under its day, under its member and
+//day, and under each resource it uses and that day, in insertion order. Dates
+//outside the testing period share one extra day. Cancelled ids and ids whose
+//booking moved to another day stay behind until a reader compacts the list.
+#define INDEX_DAYS (TESTING_DAY + 1)
+#define INDEX_OTHER_DAY TESTING_DAY     //Day of every date outside the testing period
+
+typedef struct {
+    int *ids;
+    int count;
+    int allocated;
+} IdList;
+
+IdList day_lists[INDEX_DAYS];
+IdList resource_day_lists[RESOURCE_NUM][INDEX_DAYS];
+IdList *member_day_lists = NULL;    //member_id * INDEX_DAYS + day
+int member_day_members = 0;
+
+BookingEntry* booking_index_put(Node *node, Node *prev);
+BookingEntry* booking_index_get(int booking_id);
+void booking_index_remove(int booking_id);
+void booking_index_drop_units();
+int id_list_push(IdList *list, int id);
+int booking_index_day(const Booking *booking);
+int booking_index_file(const Booking *booking);
+int booking_index_refile(const Booking *old, const Booking *updated);
+IdList* booking_index_list(int member_id, int resource, int day);
+int booking_index_compact(IdList *list, int day);
+
+BookingEntry* booking_index_put(Node *node, Node *prev) {
+    //Register a stored node under its booking id, issuing one if it has none.
+    //Return the entry, or NULL if the index could not grow.
+    int id = node->booking.booking_id;
+    if (id <= 0) id = node->booking.booking_id = booking_next_id;
+    if (id >= booking_entry_allocated) {
+        int allocated = booking_entry_allocated ? booking_entry_allocated : 1024;
+        while (allocated <= id) allocated *= 2;
+        BookingEntry *grown = (BookingEntry*)realloc(booking_entries, allocated * sizeof(BookingEntry));
+        if (!grown) {
+            perror("realloc");
+            return NULL;
+        }
+        memset(grown + booking_entry_allocated, 0, (allocated - booking_entry_allocated) * sizeof(BookingEntry));
+        booking_entries = grown;
+        booking_entry_allocated = allocated;
+    }
+    if (id >= booking_next_id) booking_next_id = id + 1;
+
+    BookingEntry *entry = &booking_entries[id];
+    entry->node = node;
+    entry->prev = prev;
+    slot_units_init(&entry->units);
+    if (!booking_index_file(&node->booking)) perror("realloc");
+    return entry;
+}
+
+BookingEntry* booking_index_get(int booking_id) {
+    //Entry of a stored booking, or NULL if there is no such booking
+    if (booking_id <= 0 || booking_id >= booking_entry_allocated) return NULL;
+    if (booking_entries[booking_id].node == NULL) return NULL;
+    return &booking_entries[booking_id];
+}
+
+void booking_index_remove(int booking_id) {
+    //The id stays issued, so a cancelled id is never reused
+    if (booking_id <= 0 || booking_id >= booking_entry_allocated) return;
+    slot_units_free(&booking_entries[booking_id].units);
+    memset(&booking_entries[booking_id], 0, sizeof(BookingEntry));
+}
+
+void booking_index_drop_units() {
+    //Forget the units of every booking, once the live slot index is gone
+    int id;
+    for (id = 1; id < booking_entry_allocated; id++) {
+        if (booking_entries[id].node) slot_units_free(&booking_entries[id].units);
+    }
+}
+
+int id_list_push(IdList *list, int id) {
+    if (list->count == list->allocated) {
+        int allocated = list->allocated ? list->allocated * 2 : 16;
+        int *grown = (int*)realloc(list->ids, allocated * sizeof(int));
+        if (!grown) return 0;
+        list->ids = grown;
+        list->allocated = allocated;
+    }
+    list->ids[list->count++] = id;
+    return 1;
+}
+
+int booking_index_day(const Booking *booking) {
+    int day = date_to_day_index(booking->date);
+    return (day >= 0 && day < TESTING_DAY) ? day : INDEX_OTHER_DAY;
+}
+
+int booking_index_file(const Booking *booking) {
+    //File a booking id in every secondary index, return 0 on failure
+    int id = booking->booking_id;
+    int member = booking->member_id;
+    int day = booking_index_day(booking);
+    if (member >= member_day_members) {
+        int members = member_day_members ? member_day_members : 8;
+        while (members <= member) members *= 2;
+        IdList *grown = (IdList*)realloc(member_day_lists, (size_t)members * INDEX_DAYS * sizeof(IdList));
+        if (!grown) return 0;
+        memset(grown + member_day_members * INDEX_DAYS, 0, (size_t)(members - member_day_members) * INDEX_DAYS * sizeof(IdList));
+        member_day_lists = grown;
+        member_day_members = members;
+    }
+
+    int ok = id_list_push(&day_lists[day], id);
+    if (member >= 0) ok &= id_list_push(&member_day_lists[member * INDEX_DAYS + day], id);
+    unsigned int mask = resource_mask(booking);
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (mask >> r & 1) ok &= id_list_push(&resource_day_lists[r][day], id);
+    }
+    return ok;
+}
+
+int booking_index_refile(const Booking *old, const Booking *updated) {
+    //Member and resources never change, so only a new day needs filing
+    if (booking_index_day(old) == booking_index_day(updated)) return 1;
+    return booking_index_file(updated);
+}
+
+IdList* booking_index_list(int member_id, int resource, int day) {
+    //Narrowest list for the given keys; pass -1 for a key that is not wanted
+    if (day < 0 || day >= INDEX_DAYS) return NULL;
+    if (member_id >= 0) return member_id < member_day_members ? &member_day_lists[member_id * INDEX_DAYS + day] : NULL;
+    if (resource >= 0) return resource < RESOURCE_NUM ? &resource_day_lists[resource][day] : NULL;
+    return &day_lists[day];
+}
+
+int booking_index_compact(IdList *list, int day) {
+    //Drop ids of cancelled bookings and of bookings moved off day, return the count left
+    int i, kept = 0;
+    for (i = 0; i < list->count; i++) {
+        BookingEntry *entry = booking_index_get(list->ids[i]);
+        if (entry && booking_index_day(&entry->node->booking) == day) list->ids[kept++] = list->ids[i];
+    }
+    list->count = kept;
+    return kept;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define MEMBER_FILE "members.dat"
+#define MEMBER_NAME_LEN 64
+
+//Member names are interned to dense integer ids (0, 1, 2, ...) in load order.
+//The hash table stores id + 1 so that 0 marks an empty bucket.
+char **member_names = NULL;
+int member_count = 0;
+int member_capacity = 0;
+int *member_table = NULL;
+int member_table_size = 0;
+
+unsigned int member_hash(const char *name);
+int member_table_rebuild(int table_size);
+int member_register(const char *name);
+int member_lookup(const char *name);
+const char* member_name(int member_id);
+int load_member_file(const char *filename);
+
+unsigned int member_hash(const char *name) {
+    //FNV-1a hash of member name
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int member_table_rebuild(int table_size) {
+    //Rehash every member into a table of table_size buckets (power of two).
+    //Return 0 and keep the old table if the new one cannot be allocated.
+    int *table = (int*)calloc(table_size, sizeof(int));
+    if (!table) {
+        perror("calloc");
+        return 0;
+    }
+    int id;
+    for (id = 0; id < member_count; id++) {
+        unsigned int bucket = member_hash(member_names[id]) & (table_size - 1);
+        while (table[bucket] != 0) {
+            bucket = (bucket + 1) & (table_size - 1);
+        }
+        table[bucket] = id + 1;
+    }
+    free(member_table);
+    member_table = table;
+    member_table_size = table_size;
+    return 1;
+}
+
+int member_register(const char *name) {
+    //Return the id of name, adding it to the registry if it is new
+    int id = member_lookup(name);
+    if (id >= 0) return id;
+
+    if (strlen(name) == 0 || strlen(name) >= MEMBER_NAME_LEN) return -1;
+
+    if (member_count == member_capacity) {
+        int capacity = member_capacity ? member_capacity * 2 : 16;
+        char **names = (char**)realloc(member_names, capacity * sizeof(char*));
+        if (!names) {
+            perror("realloc");
+            return -1;
+        }
+        member_names = names;
+        member_capacity = capacity;
+    }
+    char *copy = strdup(name);
+    if (!copy) {
+        perror("strdup");
+        return -1;
+    }
+
+    //Keep load factor at most 1/2 so probe sequences stay short. The table
+    //grows before the member is counted, so a failure leaves the registry as it was.
+    if ((member_count + 1) * 2 > member_table_size && !member_table_rebuild(member_table_size ? member_table_size * 2 : 32)) {
+        free(copy);
+        return -1;
+    }
+    unsigned int bucket = member_hash(name) & (member_table_size - 1);
+    while (member_table[bucket] != 0) {
+        bucket = (bucket + 1) & (member_table_size - 1);
+    }
+    member_names[member_count] = copy;
+    member_table[bucket] = member_count + 1;
+    return member_count++;
+}
+
+int member_lookup(const char *name) {
+    //Return the id of name, or -1 if it is not a registered member
+    if (member_table_size == 0) return -1;
+    unsigned int bucket = member_hash(name) & (member_table_size - 1);
+    while (member_table[bucket] != 0) {
+        int id = member_table[bucket] - 1;
+        if (strcmp(member_names[id], name) == 0) return id;
+        bucket = (bucket + 1) & (member_table_size - 1);
+    }
+    return -1;
+}
+
+const char* member_name(int member_id) {
+    if (member_id < 0 || member_id >= member_count) return "unknown";
+    return member_names[member_id];
+}
+
+int load_member_file(const char *filename) {
+    //Register one member name per line, return number of lines registered or -1
+    FILE *file = fopen(filename, "r");
+    if (!file) return -1;
+
+    char line[MEMBER_NAME_LEN + 2];
+    int loaded = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, " \t\r\n;")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        if (member_register(line) >= 0) loaded++;
+    }
+    fclose(file);
+    return loaded;
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define RING_SIZE 4096      //Bytes per ring, power of two; messages larger than this are streamed
+#define RING_PEER_CHECK_NS 100000000    //A sleeping side checks every 100 ms that the other one still runs
+
+//Single producer, single consumer byte ring living in a MAP_SHARED mapping.
+//head and tail count bytes ever written and read, so head - tail is the fill.
+//A side only sleeps on a futex when its ring is empty (reader) or full
+//(writer); the other side bumps the signal word and wakes it only if asked to.
+//A process that dies cannot wake anyone, so the sleep times out now and then
+//to see whether the other side's process is still there, which stands in for
+//the EOF and EPIPE a pipe gives.
+typedef struct {
+    _Atomic uint32_t head;              //Advanced by the producer
+    _Atomic uint32_t data_signal;       //Bumped on every publish and on close
+    _Atomic uint32_t reader_waiting;
+    _Atomic uint32_t closed;
+    _Atomic int32_t writer_pid;         //Producer process, 0 if not known
+    char pad1[44];
+    _Atomic uint32_t tail;              //Advanced by the consumer
+    _Atomic uint32_t space_signal;      //Bumped on every consume
+    _Atomic uint32_t writer_waiting;
+    _Atomic int32_t reader_pid;         //Consumer process, 0 if not known
+    char pad2[48];
+    unsigned char data[RING_SIZE];
+} Ring;
+
+int ring_spin_limit = -1;   //Polls before sleeping, 0 on a single CPU where spinning only delays the peer
+
+void ring_init(Ring *ring);
+int ring_peer_alive(pid_t pid);
+int ring_wait(_Atomic uint32_t *signal, uint32_t seen, _Atomic uint32_t *waiting, pid_t peer);
+void ring_wake(_Atomic uint32_t *signal, _Atomic uint32_t *waiting);
+int ring_write(Ring *ring, const void *buffer, size_t size);
+int ring_read(Ring *ring, void *buffer, size_t size);
+void ring_close(Ring *ring);
+
+void ring_init(Ring *ring) {
+    memset(ring, 0, offsetof(Ring, data));
+    if (ring_spin_limit < 0) ring_spin_limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 4096 : 0;
+}
+
+int ring_peer_alive(pid_t pid) {
+    //A dead child stays a zombie until it is reaped, which kill(pid, 0) still
+    //finds, so a child is asked about with waitid and WNOWAIT to leave it unreaped
+    if (pid <= 0) return 1;
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0) return info.si_pid == 0;
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+int ring_wait(_Atomic uint32_t *signal, uint32_t seen, _Atomic uint32_t *waiting, pid_t peer) {
+    //Sleep until signal moves past seen, return 0 if the peer process died
+    //instead. The signal was read before the ring was found empty or full, so
+    //an update racing with this call is never lost.
+    struct timespec timeout = {0, RING_PEER_CHECK_NS};
+    int alive = 1;
+    atomic_store(waiting, 1);
+    if (atomic_load(signal) == seen) {
+        if (syscall(SYS_futex, (uint32_t*)signal, FUTEX_WAIT, seen, &timeout, NULL, 0) == -1 && errno == ETIMEDOUT) alive = ring_peer_alive(peer);
+    }
+    atomic_store(waiting, 0);
+    return alive;
+}
+
+void ring_wake(_Atomic uint32_t *signal, _Atomic uint32_t *waiting) {
+    atomic_fetch_add(signal, 1);
+    if (atomic_load(waiting)) syscall(SYS_futex, (uint32_t*)signal, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+int ring_write(Ring *ring, const void *buffer, size_t size) {
+    //Copy size bytes into the ring, waiting for space when it is full.
+    //Return 0 if the reader died or closed the ring first, like EPIPE on a pipe.
+    const unsigned char *p = (const unsigned char*)buffer;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    int spins = 0;
+    while (size > 0) {
+        uint32_t seen = atomic_load(&ring->space_signal);
+        uint32_t space = RING_SIZE - (head - atomic_load_explicit(&ring->tail, memory_order_acquire));
+        if (space == 0) {
+            if (spins++ < ring_spin_limit) continue;
+            if (atomic_load(&ring->closed)) return 0;
+            if (!ring_wait(&ring->space_signal, seen, &ring->writer_waiting, atomic_load(&ring->reader_pid))) {
+                atomic_store(&ring->closed, 1);
+                return 0;
+            }
+            continue;
+        }
+        uint32_t offset = head & (RING_SIZE - 1);
+        uint32_t chunk = size < space ? size : space;
+        if (chunk > RING_SIZE - offset) chunk = RING_SIZE - offset;
+        memcpy(ring->data + offset, p, chunk);
+        head += chunk;
+        p += chunk;
+        size -= chunk;
+        spins = 0;
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+        ring_wake(&ring->data_signal, &ring->reader_waiting);
+    }
+    return 1;
+}
+
+int ring_read(Ring *ring, void *buffer, size_t size) {
+    //Copy exactly size bytes out of the ring, return 0 if it was closed or the
+    //writer died first
+    unsigned char *p = (unsigned char*)buffer;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    int spins = 0;
+    while (size > 0) {
+        uint32_t seen = atomic_load(&ring->data_signal);
+        uint32_t fill = atomic_load_explicit(&ring->head, memory_order_acquire) - tail;
+        if (fill == 0) {
+            if (atomic_load(&ring->closed)) return 0;
+            if (spins++ < ring_spin_limit) continue;
+            if (!ring_wait(&ring->data_signal, seen, &ring->reader_waiting, atomic_load(&ring->writer_pid))) {
+                //Bytes published just before the writer exited are still read,
+                //then the ring reads as closed without waiting again
+                atomic_store(&ring->closed, 1);
+            }
+            continue;
+        }
+        uint32_t offset = tail & (RING_SIZE - 1);
+        uint32_t chunk = size < fill ? size : fill;
+        if (chunk > RING_SIZE - offset) chunk = RING_SIZE - offset;
+        memcpy(p, ring->data + offset, chunk);
+        tail += chunk;
+        p += chunk;
+        size -= chunk;
+        spins = 0;
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        ring_wake(&ring->space_signal, &ring->writer_waiting);
+    }
+    return 1;
+}
+
+void ring_close(Ring *ring) {
+    //Like closing a pipe: the reader drains what is left, then ring_read returns 0
+    atomic_store(&ring->closed, 1);
+    ring_wake(&ring->data_signal, &ring->reader_waiting);
+}
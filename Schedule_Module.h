@@ -4,45 +4,94 @@
 #include <time.h>
 #include <signal.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include "node.h"
 
 #define MAX_MEMBERS 5
-#define MAX_PARKING_SPACES 10
-#define MAX_BATTERIES 3
-#define MAX_CABLES 3
-#define MAX_LOCKERS 3
-#define MAX_UMBRELLAS 3
-#define MAX_VALETS 3
-#define MAX_INFLATIONS 3
-#define TESTING_DAY 7
-#define TIME_SLOT_PER_DAY 24
-#define RESOURCE_NUM 7
-
-enum ResourceType {
-    SPACE = 0,
-    BATTERY,
-    CABLE,
-    LOCKER,
-    UMBRELLA,
-    VALET,
-    INFLATION
-};
 
 const char* TEST_START_DATE = "2025-05-10";
 
+#define DUMP_OCCUPANCY -1  //Request sent in place of start_day to collect the final slot state
+
+//Units of every resource at the site being scheduled, inherited by the resource
+//managers; the catalog defaults until a site is selected
+int resource_capacity[RESOURCE_NUM];
+
+#define TRANSPORT_PIPE 0
+#define TRANSPORT_RING 1   //Shared-memory rings from Ring_Module.h
+
 int resource_pipes_ptc[RESOURCE_NUM][2];
 int resource_pipes_ctp[RESOURCE_NUM][2];
 pid_t child_pids[RESOURCE_NUM];
 
+//Transport chosen for the next scheduling run, and the one the running managers use
+int resource_transport = TRANSPORT_RING;
+int active_transport = TRANSPORT_PIPE;
+Ring *resource_rings = NULL;   //[2 * i] parent to child, [2 * i + 1] child to parent of resource i
+
+//A scheduling policy only decides the order bookings are offered in and may
+//turn away a booking whose resources are free; the engine (run_schedule)
+//owns the time ranges, the resource managers, commits and the result lists.
+//rank is asked once per booking in store order and bookings are offered by
+//ascending rank, equal ranks in store order; NULL keeps store order.
+//accept is asked only when every resource is free; NULL accepts.
+typedef struct {
+    int member_num;         //Member ids are below this
+    int *member_ranked;     //Bookings of every member ranked so far
+    int *member_accepted;   //Bookings of every member accepted so far
+} ScheduleState;
+
+typedef struct {
+    const char *name;       //printBookings -name;
+    const char *title;      //Heading of listings and reports
+    long (*rank)(const Booking *booking, ScheduleState *state);
+    int (*accept)(const Booking *booking, const ScheduleState *state);
+} SchedulePolicy;
+
+//One booking of a run, with the rank it is offered by
+typedef struct {
+    Node *node;
+    long rank;
+    int position;           //Store order, breaks ties
+} ScheduleItem;
+
+//Bookings of a run by outcome, counted while the run sorts them
+typedef struct {
+    int booking_num;        //Every booking of the store
+    int accepted_num;
+    int rejected_num;
+    int invalid_num;        //Outside the testing period
+} ScheduleTotals;
+
+//Units in use per resource, day and time slot at the end of the last scheduling run
+int slot_occupancy[RESOURCE_NUM][TESTING_DAY][TIME_SLOT_PER_DAY];
+int slot_occupancy_valid = 0;
+
 Node* create_node(Booking booking);
 void append_node(Node **head, Booking booking);
+void append_node_tail(Node **head, Node **tail, Booking booking);
 void free_list(Node *head);
 void create_resource_managers();
+void send_request(int resource_type, const void *buffer, size_t size);
+int read_reply(int resource_type, void *buffer, size_t size);
+int read_request(int resource_type, void *buffer, size_t size);
+void send_reply(int resource_type, const void *buffer, size_t size);
 void resource_manager(int resource_type);
 void cleanup_child_processes();
+void collect_slot_occupancy();
+int read_full(int fd, void *buffer, size_t size);
+void benchmark_transport(int transport, int round_trips);
 int date_to_day_index(const char* date);
-int print_bookings_fcfs(Node* head, Node** accepted, Node** rejected);
-int print_bookings_priority(Node* head, Node** accepted, Node** rejected);
+int days_from_civil(int year, int month, int day);
+int booking_slot_range(const Booking* booking, int* start_day, int* end_day, int* start_slot, int* end_slot);
+int time_to_slot(const char* time);
+int duration_to_slots(float duration);
+int run_schedule(const SchedulePolicy *policy, Node* head, Node** accepted, Node** rejected, ScheduleTotals *totals);
+int compare_schedule_item(const void *a, const void *b);
+long rank_priority(const Booking *booking, ScheduleState *state);
+long rank_shortest(const Booking *booking, ScheduleState *state);
+long rank_member_fair(const Booking *booking, ScheduleState *state);
+const SchedulePolicy* schedule_policy_lookup(const char *name);
 
 Node* create_node(Booking booking) {
     //Create new node for linked list
@@ -67,6 +116,14 @@ void append_node(Node **head, Booking booking) {
     }
 }
 
+void append_node_tail(Node **head, Node **tail, Booking booking) {
+    //Append to a list whose last node is kept in *tail, without walking it
+    Node *new_node = create_node(booking);
+    if (*head == NULL) *head = new_node;
+    else (*tail)->next = new_node;
+    *tail = new_node;
+}
+
 void free_list(Node *head) {
     //Free linked list
     while (head != NULL) {
@@ -77,14 +134,33 @@ void free_list(Node *head) {
 }
 
 void create_resource_managers() {
-    //Create pipes and fork child processes for each resource type
+    //Create pipes or rings and fork one child process for each resource of the catalog
     int i;
-    for (i = 0; i < RESOURCE_NUM; i++) {
-        if (pipe(resource_pipes_ptc[i]) == -1) {
-            perror("pipe");
+    active_transport = resource_transport;
+    if (active_transport == TRANSPORT_RING && resource_rings == NULL) {
+        void *map = mmap(NULL, 2 * RESOURCE_NUM * sizeof(Ring), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            active_transport = TRANSPORT_PIPE;
+        } else {
+            resource_rings = (Ring*)map;
         }
-        if (pipe(resource_pipes_ctp[i]) == -1) {
-            perror("pipe");
+    }
+    fflush(stdout);     //Children must not flush the parent's pending output again
+    for (i = 0; i < resource_count; i++) {
+        if (active_transport == TRANSPORT_RING) {
+            //The parent writes requests and reads replies; the child's pid is filled in after fork
+            ring_init(&resource_rings[2 * i]);
+            ring_init(&resource_rings[2 * i + 1]);
+            atomic_store(&resource_rings[2 * i].writer_pid, getpid());
+            atomic_store(&resource_rings[2 * i + 1].reader_pid, getpid());
+        } else {
+            if (pipe(resource_pipes_ptc[i]) == -1) {
+                perror("pipe");
+            }
+            if (pipe(resource_pipes_ctp[i]) == -1) {
+                perror("pipe");
+            }
         }
 
         child_pids[i] = fork();
@@ -94,12 +170,18 @@ void create_resource_managers() {
 
         if (child_pids[i] == 0) {
             //Child process
-            close(resource_pipes_ptc[i][1]);    //Close parent to child write end
-            close(resource_pipes_ctp[i][0]);    //Close child to parent read end
+            if (active_transport == TRANSPORT_PIPE) {
+                close(resource_pipes_ptc[i][1]);    //Close parent to child write end
+                close(resource_pipes_ctp[i][0]);    //Close child to parent read end
+            }
             
             //Each child handles one resource type
             resource_manager(i);
             exit(0);
+        } else if (active_transport == TRANSPORT_RING) {
+            //Parent process: a child that dies ends the parent's waits on its rings
+            atomic_store(&resource_rings[2 * i].reader_pid, child_pids[i]);
+            atomic_store(&resource_rings[2 * i + 1].writer_pid, child_pids[i]);
         } else {
             //Parent process
             close(resource_pipes_ptc[i][0]);    //Close parent to child read end
@@ -108,108 +190,150 @@ void create_resource_managers() {
     }
 }
 
+//Message helpers used by both sides; the messages are the same for either transport
+void send_request(int resource_type, const void *buffer, size_t size) {
+    if (active_transport == TRANSPORT_RING) ring_write(&resource_rings[2 * resource_type], buffer, size);
+    else write(resource_pipes_ptc[resource_type][1], buffer, size);
+}
+
+int read_reply(int resource_type, void *buffer, size_t size) {
+    if (active_transport == TRANSPORT_RING) return ring_read(&resource_rings[2 * resource_type + 1], buffer, size);
+    return read_full(resource_pipes_ctp[resource_type][0], buffer, size);
+}
+
+int read_request(int resource_type, void *buffer, size_t size) {
+    if (active_transport == TRANSPORT_RING) return ring_read(&resource_rings[2 * resource_type], buffer, size);
+    return read_full(resource_pipes_ptc[resource_type][0], buffer, size);
+}
+
+void send_reply(int resource_type, const void *buffer, size_t size) {
+    if (active_transport == TRANSPORT_RING) ring_write(&resource_rings[2 * resource_type + 1], buffer, size);
+    else write(resource_pipes_ctp[resource_type][1], buffer, size);
+}
+
 void resource_manager(int resource_type) {
-    int max_resource_num[RESOURCE_NUM] = {MAX_PARKING_SPACES, MAX_BATTERIES, MAX_CABLES, MAX_LOCKERS, MAX_UMBRELLAS, MAX_VALETS, MAX_INFLATIONS};
-    int resource_time_slot[max_resource_num[resource_type]][TESTING_DAY][TIME_SLOT_PER_DAY];
-
-    //Initialize_time_slot
-    int resource_id;
-    for (resource_id = 0; resource_id < max_resource_num[resource_type]; resource_id++) {
-        int day;
-        for (day = 0; day < TESTING_DAY; day++) {
-            int time_slot;
-            for (time_slot = 0; time_slot < TIME_SLOT_PER_DAY; time_slot++) {
-                resource_time_slot[resource_id][day][time_slot] = 0;
-            }
-        }
+    //One bit per time slot of every unit (see Slot_Module.h), so finer slots
+    //cost bits instead of ints and a range is checked a word at a time
+    SlotWord *resource_time_slot = (SlotWord*)calloc((size_t)resource_capacity[resource_type] * SLOT_WORDS_PER_UNIT, sizeof(SlotWord));
+    //Slot-major copy for group requests (see SlotIndex)
+    int row = slot_column_words(resource_capacity[resource_type]);
+    SlotWord *columns = (SlotWord*)calloc((size_t)SLOT_HORIZON * row + 1, sizeof(SlotWord));
+    //Units picked for the group request in flight
+    uint64_t *chosen = (uint64_t*)calloc(row + 1, sizeof(uint64_t));
+    if (!resource_time_slot || !columns || !chosen) {
+        perror("calloc");
+        exit(1);
     }
 
     while (1) {
-        int start_day, end_day, start_hour, end_hour;
+        int start_day, end_day, start_slot, end_slot, count;
         int resource_id;
-        int response = 0;
+        int response[2];
         int schedule;
 
         //Read request from parent
-        if (read(resource_pipes_ptc[resource_type][0], &start_day, sizeof(int)) <= 0) break;
-        if (read(resource_pipes_ptc[resource_type][0], &end_day, sizeof(int)) <= 0) break;
-        if (read(resource_pipes_ptc[resource_type][0], &start_hour, sizeof(int)) <= 0) break;
-        if (read(resource_pipes_ptc[resource_type][0], &end_hour, sizeof(int)) <= 0) break;
-        // Check availability based on resource type
-        for (resource_id = 0; resource_id < max_resource_num[resource_type]; resource_id++) {
-            int available = 1;
-            int day;
-            for (day = start_day; day <= end_day; day++) {
-                int start_time_slot = start_hour;
-                int end_time_slot = end_hour;
-    
-                //If not start day, the time slot is start from 0
-                if (day != start_day) {
-                    start_time_slot = 0;
-                }
-    
-                //If not end day, the time slot is end by last time slot
-                if (day != end_day) {
-                    end_time_slot = TIME_SLOT_PER_DAY - 1;
-                }
-
-                int time_slot;
-                for (time_slot = start_time_slot; time_slot <= end_time_slot; time_slot++) {
-                    if (resource_time_slot[resource_id][day][time_slot] != 0) {
-                        //The time slot is not available
-                        available = 0;
-                        break;
+        if (!read_request(resource_type, &start_day, sizeof(int))) break;
+        if (start_day == DUMP_OCCUPANCY) {
+            //Send the number of units in use for every day and time slot
+            int occupancy[TESTING_DAY][TIME_SLOT_PER_DAY] = {{0}};
+            for (resource_id = 0; resource_id < resource_capacity[resource_type]; resource_id++) {
+                SlotWord *unit = resource_time_slot + (size_t)resource_id * SLOT_WORDS_PER_UNIT;
+                int word;
+                for (word = 0; word < SLOT_WORDS_PER_UNIT; word++) {
+                    uint64_t bits = unit[word];
+                    while (bits) {
+                        int slot = word * 64 + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        if (slot < TESTING_DAY * TIME_SLOT_PER_DAY) occupancy[slot / TIME_SLOT_PER_DAY][slot % TIME_SLOT_PER_DAY]++;
                     }
                 }
-                if (!available) {
-                    //The time slot is not available
-                    break;
-                }
-            }
-            if (available) {
-                //The time slot is available
-                response = 1;
-                break;
             }
+            send_reply(resource_type, occupancy, sizeof(occupancy));
+            continue;
         }
+        if (!read_request(resource_type, &end_day, sizeof(int))) break;
+        if (!read_request(resource_type, &start_slot, sizeof(int))) break;
+        if (!read_request(resource_type, &end_slot, sizeof(int))) break;
+        if (!read_request(resource_type, &count, sizeof(int))) break;
+        //Days and slots of the request form one inclusive range over the testing period
+        int first = start_day * TIME_SLOT_PER_DAY + start_slot;
+        int last = end_day * TIME_SLOT_PER_DAY + end_slot;
+        //Pick a unit free over the range by the placement policy inherited at
+        //fork, or for a group any count free units, adjacent ones if possible
+        int adjacent = 1;
+        if (count <= 1) resource_id = slot_place_unit(resource_time_slot, resource_capacity[resource_type], first, last, placement_policy);
+        else if (count <= resource_capacity[resource_type]) {
+            resource_id = slot_columns_choose(columns, resource_capacity[resource_type], first, last, count, chosen);
+            adjacent = slot_set_adjacent(chosen, row);
+        } else resource_id = -1;
+        //Reply the (lowest) unit plus one, 0 when no unit is free, and whether
+        //the units of a group are adjacent
+        response[0] = resource_id + 1;
+        response[1] = adjacent;
         //Send response back to parent
-        write(resource_pipes_ctp[resource_type][1], &response, sizeof(int));
+        send_reply(resource_type, response, sizeof(response));
         //Read schedule request
-        if (read(resource_pipes_ptc[resource_type][0], &schedule, sizeof(int)) <= 0) break;
-        if (schedule) {
-            int day;
-            for (day = start_day; day <= end_day; day++) {
-                int start_time_slot = start_hour;
-                int end_time_slot = end_hour;
-
-                //If not start day, the time slot is start from 0
-                if (day != start_day) {
-                    start_time_slot = 0;
-                }
-
-                //If not end day, the time slot is end by last time slot
-                if (day != end_day) {
-                    end_time_slot = TIME_SLOT_PER_DAY - 1;
-                }
-                int time_slot;
-                for (time_slot = start_time_slot; time_slot <= end_time_slot; time_slot++) {
-                    resource_time_slot[resource_id][day][time_slot] = 1;
+        if (!read_request(resource_type, &schedule, sizeof(int))) break;
+        if (schedule && resource_id >= 0 && count <= 1) {
+            slot_range_set(resource_time_slot + (size_t)resource_id * SLOT_WORDS_PER_UNIT, first, last);
+            slot_columns_mark(columns, resource_capacity[resource_type], resource_id, 1, first, last, 1);
+        } else if (schedule && resource_id >= 0) {
+            int word;
+            for (word = 0; word < row; word++) {
+                uint64_t bits = chosen[word];
+                while (bits) {
+                    slot_range_set(resource_time_slot + (size_t)(word * 64 + __builtin_ctzll(bits)) * SLOT_WORDS_PER_UNIT, first, last);
+                    bits &= bits - 1;
                 }
             }
+            slot_columns_mark_set(columns, resource_capacity[resource_type], chosen, row, first, last, 1);
         }
         //Send schedule complete signal
         int receiver = 1;
-        write(resource_pipes_ctp[resource_type][1], &receiver, sizeof(int));
+        send_reply(resource_type, &receiver, sizeof(int));
+    }
+    free(resource_time_slot);
+    free(columns);
+    free(chosen);
+    if (active_transport == TRANSPORT_PIPE) {
+        close(resource_pipes_ptc[resource_type][0]);    //Close parent to child read end
+        close(resource_pipes_ctp[resource_type][1]);    //Close child to parent write end
     }
-    close(resource_pipes_ptc[resource_type][0]);    //Close parent to child read end
-    close(resource_pipes_ctp[resource_type][1]);    //Close child to parent write end
     exit(0);
 }
 
+void collect_slot_occupancy() {
+    //Ask every resource manager for its final slot state
+    int i;
+    int request = DUMP_OCCUPANCY;
+    memset(slot_occupancy, 0, sizeof(slot_occupancy));
+    slot_occupancy_valid = 1;
+    for (i = 0; i < resource_count; i++) {
+        send_request(i, &request, sizeof(int));
+        if (!read_reply(i, slot_occupancy[i], sizeof(slot_occupancy[i]))) {
+            slot_occupancy_valid = 0;
+        }
+    }
+}
+
+int read_full(int fd, void *buffer, size_t size) {
+    //Read exactly size bytes, return 0 on EOF or error
+    char *p = (char*)buffer;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
 void cleanup_child_processes() {
     int i;
-    for (i = 0; i < RESOURCE_NUM; i++) {
-        close(resource_pipes_ptc[i][1]);    //Close parent's write end
+    collect_slot_occupancy();
+    for (i = 0; i < resource_count; i++) {
+        if (active_transport == TRANSPORT_RING) ring_close(&resource_rings[2 * i]);
+        else close(resource_pipes_ptc[i][1]);    //Close parent's write end
         if (kill(child_pids[i], SIGTERM) == -1) {   //Send termination signal
             perror("kill");
         }
@@ -217,454 +341,225 @@ void cleanup_child_processes() {
     }
 }
 
+void benchmark_transport(int transport, int round_trips) {
+    //Time availability probes against a fresh parking space manager; the slot
+    //state of the last scheduling run is kept
+    int saved_valid = slot_occupancy_valid;
+    int (*saved)[TESTING_DAY][TIME_SLOT_PER_DAY] = malloc(sizeof(slot_occupancy));
+    if (!saved) return;
+    memcpy(saved, slot_occupancy, sizeof(slot_occupancy));
+
+    int saved_transport = resource_transport;
+    resource_transport = transport;
+    create_resource_managers();
+    struct timespec start, end;
+    int i, probe[5] = {0, 0, 8, 10, 1}, answer[2], schedule = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < round_trips; i++) {
+        send_request(SPACE, probe, sizeof(probe));
+        read_reply(SPACE, answer, sizeof(answer));
+        send_request(SPACE, &schedule, sizeof(int));
+        read_reply(SPACE, answer, sizeof(int));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    int used = active_transport;
+    cleanup_child_processes();
+    resource_transport = saved_transport;
+
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / (2.0 * round_trips);
+    printf("%-10s%-12d%-16.0f\n", used == TRANSPORT_RING ? "ring" : "pipe", round_trips, ns);
+
+    memcpy(slot_occupancy, saved, sizeof(slot_occupancy));
+    slot_occupancy_valid = saved_valid;
+    free(saved);
+}
+
 int date_to_day_index(const char* date) {
     //Parse the date to day index of time slot
-    struct tm start_tm = {0};
-    struct tm current_tm = {0};
-    
-    //Parse TEST_START_DATE
-    strptime(TEST_START_DATE, "%Y-%m-%d", &start_tm);
-    time_t start_time = mktime(&start_tm);
-    
-    //Parse input date
-    strptime(date, "%Y-%m-%d", &current_tm);
-    time_t current_time = mktime(&current_tm);
-    
-    //Calculate difference in seconds
-    double seconds = difftime(current_time, start_time);
-    
-    //Convert to days (86400 seconds per day)
-    int days = (int)(seconds / 86400);
-    
+    //Computed with calendar arithmetic instead of strptime/mktime, which cost
+    //microseconds per call and depend on the local time zone
+    int year = atoi(date);
+    int month = (date[5] - '0') * 10 + (date[6] - '0');
+    int day = (date[8] - '0') * 10 + (date[9] - '0');
+    int start_year = atoi(TEST_START_DATE);
+    int start_month = (TEST_START_DATE[5] - '0') * 10 + (TEST_START_DATE[6] - '0');
+    int start_day = (TEST_START_DATE[8] - '0') * 10 + (TEST_START_DATE[9] - '0');
+
+    int days = days_from_civil(year, month, day) - days_from_civil(start_year, start_month, start_day);
     return (days >= 0) ? days : -1;
 }
 
-int print_bookings_fcfs(Node* head, Node** accepted, Node** rejected) {
-    create_resource_managers();
+int days_from_civil(int year, int month, int day) {
+    //Days since 1970-01-01 in the proleptic Gregorian calendar
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int year_of_era = year - era * 400;
+    int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+int booking_slot_range(const Booking* booking, int* start_day, int* end_day, int* start_slot, int* end_slot) {
+    //Convert a booking to its first and last time slot, return 0 if not in testing period
+    *start_day = date_to_day_index(booking->date);
+    if (*start_day < 0 || *start_day >= TESTING_DAY) return 0;
+    *end_day = *start_day;
+    *start_slot = time_to_slot(booking->time);
+    *end_slot = *start_slot + duration_to_slots(booking->duration);
+    while (*end_slot > TIME_SLOT_PER_DAY) {
+        (*end_day)++;
+        *end_slot -= TIME_SLOT_PER_DAY;
+    }
+    if (*end_day < 0 || *end_day >= TESTING_DAY) return 0;
+    return 1;
+}
+
+int time_to_slot(const char* time) {
+    //Slot of the day that contains hh:mm
+    return (atoi(time) * 60 + atoi(time + 3)) / SLOT_MINUTES;
+}
+
+int duration_to_slots(float duration) {
+    //Whole number of slots covered by a duration given in hours
+    float slots = duration * 60 / SLOT_MINUTES;
+    return (int)(slots + 0.5f);
+}
+
+//Policies of printBookings; the first SCHEDULE_SUMMARY_POLICIES are the ones
+//the summary and breakdown reports compare
+const SchedulePolicy schedule_policies[] = {
+    {"fcfs", "FCFS", NULL, NULL},
+    {"prio", "PRIO", rank_priority, NULL},
+    {"shortest", "SHORTEST", rank_shortest, NULL},
+    {"fair", "FAIR", rank_member_fair, NULL},
+};
+#define SCHEDULE_POLICY_NUM ((int)(sizeof(schedule_policies) / sizeof(schedule_policies[0])))
+#define SCHEDULE_SUMMARY_POLICIES 2
+
+int run_schedule(const SchedulePolicy *policy, Node* head, Node** accepted, Node** rejected, ScheduleTotals *totals) {
+    //Offer every booking in policy order to the resource managers. A booking is
+    //accepted when each resource it asks for has units free over its range and
+    //the policy agrees; its units are then committed. Return the bookings
+    //outside the testing period, and all counts in totals unless it is NULL.
     *accepted = NULL;
     *rejected = NULL;
+    Node *accepted_tail = NULL, *rejected_tail = NULL;
+    ScheduleTotals counted;
+    memset(&counted, 0, sizeof(counted));
+
+    int n = 0, i;
+    ScheduleState state;
+    memset(&state, 0, sizeof(state));
+    Node* current;
+    for (current = head; current != NULL; current = current->next) {
+        n++;
+        if (current->booking.member_id >= state.member_num) state.member_num = current->booking.member_id + 1;
+    }
+    ScheduleItem *items = (ScheduleItem*)malloc((n + 1) * sizeof(ScheduleItem));
+    state.member_ranked = (int*)calloc(state.member_num + 1, sizeof(int));
+    state.member_accepted = (int*)calloc(state.member_num + 1, sizeof(int));
+    if (!items || !state.member_ranked || !state.member_accepted) {
+        perror("malloc");
+        free(items);
+        free(state.member_ranked);
+        free(state.member_accepted);
+        if (totals) *totals = counted;
+        return 0;
+    }
+    for (i = 0, current = head; current != NULL; i++, current = current->next) {
+        items[i].node = current;
+        items[i].rank = policy->rank ? policy->rank(&current->booking, &state) : 0;
+        items[i].position = i;
+    }
+    if (policy->rank) qsort(items, n, sizeof(ScheduleItem), compare_schedule_item);
 
-    Node* current = head;
-
+    create_resource_managers();
     int invalid_requests = 0;
-    while (current != NULL) {
-        Booking booking = current->booking;
+    for (i = 0; i < n; i++) {
+        Booking booking = items[i].node->booking;
 
-        //Convert the date to day index
-        int start_day = date_to_day_index(booking.date);
-        if (start_day < 0 || start_day >= TESTING_DAY) {    //Not in testing period
+        //Get start and end day and time slots
+        int start_day, end_day, start_slot, end_slot;
+        if (!booking_slot_range(&booking, &start_day, &end_day, &start_slot, &end_slot)) {    //Not in testing period
             invalid_requests++;
-            current = current->next;
             continue;
         }
-        int end_day = start_day;
-        //Get start and end time slots
-        int start_hour = atoi(booking.time);
-        int end_hour = start_hour + (int)booking.duration;
-        while (end_hour > TIME_SLOT_PER_DAY) {
-            end_day++;
-            end_hour -= 24;
-        }
 
-        if (end_day < 0 || end_day >= TESTING_DAY) {    //Not in testing period
-            invalid_requests++;
-            current = current->next;
-            continue;
-        }
-
-        //Check all requested space or items are available or not
+        //Probe the manager of every requested resource
         int all_request_available = 1;  //Default true
-        //Check parking space availability
-        if (booking.parking_space) {
-            int available;
-            write(resource_pipes_ptc[SPACE][1], &start_day, sizeof(int));
-            write(resource_pipes_ptc[SPACE][1], &end_day, sizeof(int));
-            write(resource_pipes_ptc[SPACE][1], &start_hour, sizeof(int));
-            write(resource_pipes_ptc[SPACE][1], &end_hour, sizeof(int));
-            read(resource_pipes_ctp[SPACE][0], &available, sizeof(int));
-            if (!available) {
-                //If parking space is not available
-                all_request_available = 0;
-            }
-        }
-        //Check battery availability
-        if (booking.battery) {
-            int available;
-            write(resource_pipes_ptc[BATTERY][1], &start_day, sizeof(int));
-            write(resource_pipes_ptc[BATTERY][1], &end_day, sizeof(int));
-            write(resource_pipes_ptc[BATTERY][1], &start_hour, sizeof(int));
-            write(resource_pipes_ptc[BATTERY][1], &end_hour, sizeof(int));
-            read(resource_pipes_ctp[BATTERY][0], &available, sizeof(int));
-            if (!available) {
-                //If battery is not available
-                all_request_available = 0;
-            }
-        }
-        //Check cable availability
-        if (booking.cable) {
-            int available;
-            write(resource_pipes_ptc[CABLE][1], &start_day, sizeof(int));
-            write(resource_pipes_ptc[CABLE][1], &end_day, sizeof(int));
-            write(resource_pipes_ptc[CABLE][1], &start_hour, sizeof(int));
-            write(resource_pipes_ptc[CABLE][1], &end_hour, sizeof(int));
-            read(resource_pipes_ctp[CABLE][0], &available, sizeof(int));
-            if (!available) {
-                //If cable is not available
-                all_request_available = 0;
-            }
-        }
-        //Check locker availability
-        if (booking.locker) {
-            int available;
-            write(resource_pipes_ptc[LOCKER][1], &start_day, sizeof(int));
-            write(resource_pipes_ptc[LOCKER][1], &end_day, sizeof(int));
-            write(resource_pipes_ptc[LOCKER][1], &start_hour, sizeof(int));
-            write(resource_pipes_ptc[LOCKER][1], &end_hour, sizeof(int));
-            read(resource_pipes_ctp[LOCKER][0], &available, sizeof(int));
-            if (!available) {
-                //If locker is not available
-                all_request_available = 0;
-            }
-        }
-        //Check umbrella availability
-        if (booking.umbrella) {
-            int available;
-            write(resource_pipes_ptc[UMBRELLA][1], &start_day, sizeof(int));
-            write(resource_pipes_ptc[UMBRELLA][1], &end_day, sizeof(int));
-            write(resource_pipes_ptc[UMBRELLA][1], &start_hour, sizeof(int));
-            write(resource_pipes_ptc[UMBRELLA][1], &end_hour, sizeof(int));
-            read(resource_pipes_ctp[UMBRELLA][0], &available, sizeof(int));
-            if (!available) {
-                //If umbrella is not available
-                all_request_available = 0;
-            }
-        }
-        //Check valet availability
-        if (booking.valet) {
-            int available;
-            write(resource_pipes_ptc[VALET][1], &start_day, sizeof(int));
-            write(resource_pipes_ptc[VALET][1], &end_day, sizeof(int));
-            write(resource_pipes_ptc[VALET][1], &start_hour, sizeof(int));
-            write(resource_pipes_ptc[VALET][1], &end_hour, sizeof(int));
-            read(resource_pipes_ctp[VALET][0], &available, sizeof(int));
-            if (!available) {
-                //If valet is not available
-                all_request_available = 0;
-            }
-        }
-        //Check inflation availability
-        if (booking.inflation) {
-            int available;
-            write(resource_pipes_ptc[INFLATION][1], &start_day, sizeof(int));
-            write(resource_pipes_ptc[INFLATION][1], &end_day, sizeof(int));
-            write(resource_pipes_ptc[INFLATION][1], &start_hour, sizeof(int));
-            write(resource_pipes_ptc[INFLATION][1], &end_hour, sizeof(int));
-            read(resource_pipes_ctp[INFLATION][0], &available, sizeof(int));
-            if (!available) {
-                //If inflation is not available
-                all_request_available = 0;
-            }
+        unsigned int mask = resource_mask(&booking), bits;
+        for (bits = mask; bits; bits &= bits - 1) {
+            int r = __builtin_ctz(bits);
+            int request[5] = {start_day, end_day, start_slot, end_slot, booking.quantity[r]};
+            int reply[2] = {0, 1};  //Lowest unit plus one, 0 if none free, and whether a group is adjacent
+            send_request(r, request, sizeof(request));
+            read_reply(r, reply, sizeof(reply));
+            booking.units[r] = reply[0] - 1;
+            if (!reply[1]) booking.scattered |= 1u << r;
+            if (!reply[0]) all_request_available = 0;
         }
+        if (all_request_available && policy->accept && !policy->accept(&booking, &state)) all_request_available = 0;
 
         if (all_request_available) {    //All space and items are available
-            //Add to accepted list
-            if (*accepted == NULL) {  //Accepted list is null
-                *accepted = create_node(booking);
-            } else {    //Accepted list is not null
-                append_node(accepted, booking);
-            }
+            append_node_tail(accepted, &accepted_tail, booking);
+            counted.accepted_num++;
+            if (booking.member_id >= 0) state.member_accepted[booking.member_id]++;
         } else {    //All space and items are not available
-            //Add to rejected list
-            if (*rejected == NULL) {  //Rejected list is null
-                *rejected = create_node(booking);
-            } else {    //Rejected list is not null
-                append_node(rejected, booking);
-            }
+            //Units probed for a rejected booking are not kept
+            memset(booking.units, -1, sizeof(booking.units));
+            booking.scattered = 0;
+            append_node_tail(rejected, &rejected_tail, booking);
+            counted.rejected_num++;
         }
 
         //Send schedule time slot signal
-        if (booking.parking_space) {
-            write(resource_pipes_ptc[SPACE][1], &all_request_available, sizeof(int));
-            int receiver;
-            read(resource_pipes_ctp[SPACE][0], &receiver, sizeof(int));
-        }
-        if (booking.battery) {
-            write(resource_pipes_ptc[BATTERY][1], &all_request_available, sizeof(int));
-            int receiver;
-            read(resource_pipes_ctp[BATTERY][0], &receiver, sizeof(int));
-        }
-        if (booking.cable) {
-            write(resource_pipes_ptc[CABLE][1], &all_request_available, sizeof(int));
-            int receiver;
-            read(resource_pipes_ctp[CABLE][0], &receiver, sizeof(int));
-        }
-        if (booking.locker) {
-            write(resource_pipes_ptc[LOCKER][1], &all_request_available, sizeof(int));
+        for (bits = mask; bits; bits &= bits - 1) {
+            int r = __builtin_ctz(bits);
             int receiver;
-            read(resource_pipes_ctp[LOCKER][0], &receiver, sizeof(int));
+            send_request(r, &all_request_available, sizeof(int));
+            read_reply(r, &receiver, sizeof(int));
         }
-        if (booking.umbrella) {
-            write(resource_pipes_ptc[UMBRELLA][1], &all_request_available, sizeof(int));
-            int receiver;
-            read(resource_pipes_ctp[UMBRELLA][0], &receiver, sizeof(int));
-        }
-        if (booking.valet) {
-            write(resource_pipes_ptc[VALET][1], &all_request_available, sizeof(int));
-            int receiver;
-            read(resource_pipes_ctp[VALET][0], &receiver, sizeof(int));
-        }
-        if (booking.inflation) {
-            write(resource_pipes_ptc[INFLATION][1], &all_request_available, sizeof(int));
-            int receiver;
-            read(resource_pipes_ctp[INFLATION][0], &receiver, sizeof(int));
-        }
-
-        current = current->next;
     }
-    
-    cleanup_child_processes();
 
+    cleanup_child_processes();
+    free(items);
+    free(state.member_ranked);
+    free(state.member_accepted);
+    counted.booking_num = n;
+    counted.invalid_num = invalid_requests;
+    if (totals) *totals = counted;
     return invalid_requests;
 }
 
-int print_bookings_priority(Node* head, Node** accepted, Node** rejected) {
-    create_resource_managers();
-    *accepted = NULL;
-    *rejected = NULL;
-
-    //Create separate lists for each priority level
-    Node* priority_lists[4] = {NULL}; // Index 0 unused, priorities are 1-4
-
-    //Sort bookings into priority lists
-    Node* current = head;
-    while (current != NULL) {
-        Booking booking = current->booking;
-        
-        //Insert into appropriate priority list
-        if (booking.priority == 4) {
-            if (priority_lists[3] == NULL) {
-                priority_lists[3] = create_node(booking);
-            } else {
-                append_node(&priority_lists[3], booking);
-            }
-        } else if (booking.priority == 3) {
-            if (priority_lists[2] == NULL) {
-                priority_lists[2] = create_node(booking);
-            } else {
-                append_node(&priority_lists[2], booking);
-            }
-        } else if (booking.priority == 2) {
-            if (priority_lists[1] == NULL) {
-                priority_lists[1] = create_node(booking);
-            } else {
-                append_node(&priority_lists[1], booking);
-            }
-        } else {
-            if (priority_lists[0] == NULL) {
-                priority_lists[0] = create_node(booking);
-            } else {
-                append_node(&priority_lists[0], booking);
-            }
-        }
-        current = current->next;
-    }
-    
-    //Process bookings in priority order (4 first, then 3, then 2, then 1)
-    int invalid_requests = 0;
-    int prio;
-    for (prio = 3; prio >= 0; prio--) {
-        current = priority_lists[prio];
-        while (current != NULL) {
-            Booking booking = current->booking;
-
-            //Convert the date to day index
-            int start_day = date_to_day_index(booking.date);
-            if (start_day < 0 || start_day >= TESTING_DAY) {    //Not in testing period
-                invalid_requests++;
-                current = current->next;
-                continue;
-            }
-            int end_day = start_day;
-
-            //Get start and end time slots
-            int start_hour = atoi(booking.time);
-            int end_hour = start_hour + (int)booking.duration;
-            while (end_hour > TIME_SLOT_PER_DAY) {
-                end_day++;
-                end_hour -= 24;
-            }
-
-            if (end_day < 0 || end_day >= TESTING_DAY) {    //Not in testing period
-                invalid_requests++;
-                current = current->next;
-                continue;
-            }
-
-            //Check all requested space or items are available or not
-            int all_request_available = 1;  //Default true
-            
-            //Check parking space availability
-            if (booking.parking_space) {
-                int available;
-                write(resource_pipes_ptc[SPACE][1], &start_day, sizeof(int));
-                write(resource_pipes_ptc[SPACE][1], &end_day, sizeof(int));
-                write(resource_pipes_ptc[SPACE][1], &start_hour, sizeof(int));
-                write(resource_pipes_ptc[SPACE][1], &end_hour, sizeof(int));
-                read(resource_pipes_ctp[SPACE][0], &available, sizeof(int));
-                if (!available) {
-                    //If parking space is not available
-                    all_request_available = 0;
-                }
-            }
-            
-            //Check battery availability
-            if (booking.battery) {
-                int available;
-                write(resource_pipes_ptc[BATTERY][1], &start_day, sizeof(int));
-                write(resource_pipes_ptc[BATTERY][1], &end_day, sizeof(int));
-                write(resource_pipes_ptc[BATTERY][1], &start_hour, sizeof(int));
-                write(resource_pipes_ptc[BATTERY][1], &end_hour, sizeof(int));
-                read(resource_pipes_ctp[BATTERY][0], &available, sizeof(int));
-                if (!available) {
-                    //If battery is not available
-                    all_request_available = 0;
-                }
-            }
-            
-            //Check cable availability
-            if (booking.cable) {
-                int available;
-                write(resource_pipes_ptc[CABLE][1], &start_day, sizeof(int));
-                write(resource_pipes_ptc[CABLE][1], &end_day, sizeof(int));
-                write(resource_pipes_ptc[CABLE][1], &start_hour, sizeof(int));
-                write(resource_pipes_ptc[CABLE][1], &end_hour, sizeof(int));
-                read(resource_pipes_ctp[CABLE][0], &available, sizeof(int));
-                if (!available) {
-                    //If cable is not available
-                    all_request_available = 0;
-                }
-            }
-            
-            //Check locker availability
-            if (booking.locker) {
-                int available;
-                write(resource_pipes_ptc[LOCKER][1], &start_day, sizeof(int));
-                write(resource_pipes_ptc[LOCKER][1], &end_day, sizeof(int));
-                write(resource_pipes_ptc[LOCKER][1], &start_hour, sizeof(int));
-                write(resource_pipes_ptc[LOCKER][1], &end_hour, sizeof(int));
-                read(resource_pipes_ctp[LOCKER][0], &available, sizeof(int));
-                if (!available) {
-                    //If locker is not available
-                    all_request_available = 0;
-                }
-            }
-
-            //Check umbrella availability
-            if (booking.umbrella) {
-                int available;
-                write(resource_pipes_ptc[UMBRELLA][1], &start_day, sizeof(int));
-                write(resource_pipes_ptc[UMBRELLA][1], &end_day, sizeof(int));
-                write(resource_pipes_ptc[UMBRELLA][1], &start_hour, sizeof(int));
-                write(resource_pipes_ptc[UMBRELLA][1], &end_hour, sizeof(int));
-                read(resource_pipes_ctp[UMBRELLA][0], &available, sizeof(int));
-                if (!available) {
-                    //If umbrella is not available
-                    all_request_available = 0;
-                }
-            }
-
-            //Check valet availability
-            if (booking.valet) {
-                int available;
-                write(resource_pipes_ptc[VALET][1], &start_day, sizeof(int));
-                write(resource_pipes_ptc[VALET][1], &end_day, sizeof(int));
-                write(resource_pipes_ptc[VALET][1], &start_hour, sizeof(int));
-                write(resource_pipes_ptc[VALET][1], &end_hour, sizeof(int));
-                read(resource_pipes_ctp[VALET][0], &available, sizeof(int));
-                if (!available) {
-                    //If valet is not available
-                    all_request_available = 0;
-                }
-            }
-
-            //Check inflation availability
-            if (booking.inflation) {
-                int available;
-                write(resource_pipes_ptc[INFLATION][1], &start_day, sizeof(int));
-                write(resource_pipes_ptc[INFLATION][1], &end_day, sizeof(int));
-                write(resource_pipes_ptc[INFLATION][1], &start_hour, sizeof(int));
-                write(resource_pipes_ptc[INFLATION][1], &end_hour, sizeof(int));
-                read(resource_pipes_ctp[INFLATION][0], &available, sizeof(int));
-                if (!available) {
-                    //If inflation is not available
-                    all_request_available = 0;
-                }
-            }
+int compare_schedule_item(const void *a, const void *b) {
+    const ScheduleItem *x = (const ScheduleItem*)a, *y = (const ScheduleItem*)b;
+    if (x->rank != y->rank) return (x->rank > y->rank) - (x->rank < y->rank);
+    return (x->position > y->position) - (x->position < y->position);
+}
 
-            if (all_request_available) {    //All space and items are available
-                //Add to accepted list
-                if (*accepted == NULL) { //Accepted list is null
-                    *accepted = create_node(booking);
-                } else {    //Accepted list is not null
-                    append_node(accepted, booking);
-                }
-            } else {    // Not all resources available
-                // Add to rejected list
-                if (*rejected == NULL) {
-                    *rejected = create_node(booking);
-                } else {
-                    append_node(rejected, booking);
-                }
-            }
+long rank_priority(const Booking *booking, ScheduleState *state) {
+    //Events first, then reservations, parking and essentials
+    (void)state;
+    return -booking->priority;
+}
 
-            //Send schedule time slot signal
-            if (booking.parking_space) {
-                write(resource_pipes_ptc[SPACE][1], &all_request_available, sizeof(int));
-                int receiver;
-                read(resource_pipes_ctp[SPACE][0], &receiver, sizeof(int));
-            }
-            if (booking.battery) {
-                write(resource_pipes_ptc[BATTERY][1], &all_request_available, sizeof(int));
-                int receiver;
-                read(resource_pipes_ctp[BATTERY][0], &receiver, sizeof(int));
-            }
-            if (booking.cable) {
-                write(resource_pipes_ptc[CABLE][1], &all_request_available, sizeof(int));
-                int receiver;
-                read(resource_pipes_ctp[CABLE][0], &receiver, sizeof(int));
-            }
-            if (booking.locker) {
-                write(resource_pipes_ptc[LOCKER][1], &all_request_available, sizeof(int));
-                int receiver;
-                read(resource_pipes_ctp[LOCKER][0], &receiver, sizeof(int));
-            }
-            if (booking.umbrella) {
-                write(resource_pipes_ptc[UMBRELLA][1], &all_request_available, sizeof(int));
-                int receiver;
-                read(resource_pipes_ctp[UMBRELLA][0], &receiver, sizeof(int));
-            }
-            if (booking.valet) {
-                write(resource_pipes_ptc[VALET][1], &all_request_available, sizeof(int));
-                int receiver;
-                read(resource_pipes_ctp[VALET][0], &receiver, sizeof(int));
-            }
-            if (booking.inflation) {
-                write(resource_pipes_ptc[INFLATION][1], &all_request_available, sizeof(int));
-                int receiver;
-                read(resource_pipes_ctp[INFLATION][0], &receiver, sizeof(int));
-            }
+long rank_shortest(const Booking *booking, ScheduleState *state) {
+    //Shortest bookings first, so more of them fit
+    (void)state;
+    return duration_to_slots(booking->duration);
+}
 
-            current = current->next;
-        }
-    }
+long rank_member_fair(const Booking *booking, ScheduleState *state) {
+    //Round robin over members: everyone's n-th booking before anyone's n+1-th
+    if (booking->member_id < 0) return 0;
+    return state->member_ranked[booking->member_id]++;
+}
 
-    //Free priority lists
-    int i;
-    for (i = 0; i < 4; i++) {
-        free_list(priority_lists[i]);
+const SchedulePolicy* schedule_policy_lookup(const char *name) {
+    //Policy called name, or NULL
+    int p;
+    for (p = 0; p < SCHEDULE_POLICY_NUM; p++) {
+        if (strcmp(schedule_policies[p].name, name) == 0) return &schedule_policies[p];
     }
-
-    cleanup_child_processes();
-
-    return invalid_requests;
-}
\ No newline at end of file
+    return NULL;
+}
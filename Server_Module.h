@@ -0,0 +1,484 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVER_IO_THREADS 4
+#define SERVER_MAX_EVENTS 64
+#define SERVER_READ_SIZE 65536
+#define SERVER_COMMAND_SIZE 256
+#define SERVER_SHUTDOWN_COMMAND "shutdownServer"
+#define SERVER_TOO_LONG_REPLY "TOO_LONG"
+#define SERVER_MAX_BACKLOG (1 << 20)    //Unsent reply bytes a client may pile up before it is dropped
+
+//One client connection, owned by a single I/O thread. Every batch in flight
+//holds a reference, so the fd is only closed after its last reply is sent.
+//Replies the socket does not take at once wait in out until the I/O thread
+//sees EPOLLOUT, so a client that reads slowly never holds up the engine.
+typedef struct ServerConnection {
+    struct ServerConnection *prev, *next;   //Open connections, guarded by server_connections_lock
+    int fd;
+    int epoll_fd;                       //epoll of the owning I/O thread
+    atomic_int refs;
+    pthread_mutex_t out_lock;           //Guards the fields below
+    char *out;                          //Reply bytes not sent yet, from out_sent to out_length
+    int out_sent;
+    int out_length;
+    int out_capacity;
+    int writing;                        //EPOLLOUT is armed
+    int dropped;                        //Backlog too long or send failed, the socket is shut down
+    int length;                         //Bytes of an incomplete command kept in pending
+    int overflow;                       //The incomplete command did not fit in pending
+    char pending[SERVER_COMMAND_SIZE];
+} ServerConnection;
+
+//All complete commands from one read, separated by '\0'. An empty command
+//stands for one that was too long and gets an error reply instead of running.
+typedef struct ServerBatch {
+    struct ServerBatch *_Atomic next;
+    ServerConnection *connection;
+    int count;
+    int length;
+    char text[];
+} ServerBatch;
+
+//Intrusive multi-producer single-consumer queue: producers swap themselves
+//into head, the single consumer walks from tail without locks
+typedef struct {
+    ServerBatch *_Atomic head;
+    ServerBatch *tail;
+    ServerBatch stub;
+} ServerQueue;
+
+typedef struct {
+    int epoll_fd;
+    pthread_t thread;
+} ServerWorker;
+
+ServerQueue server_queue;
+ServerConnection *server_connections = NULL;
+pthread_mutex_t server_connections_lock = PTHREAD_MUTEX_INITIALIZER;
+ServerWorker server_workers[SERVER_IO_THREADS];
+int server_listen_fd = -1;
+int server_wakeup_fd = -1;      //Wakes the engine when it sleeps on an empty queue
+int server_stop_fd = -1;        //Readable once the server is shutting down
+atomic_int server_engine_sleeping;
+atomic_int server_running;
+
+void server_queue_init(ServerQueue *queue);
+void server_queue_push(ServerQueue *queue, ServerBatch *batch);
+ServerBatch* server_queue_pop(ServerQueue *queue);
+void server_connection_release(ServerConnection *connection);
+void server_connection_unlink(ServerConnection *connection);
+void server_submit(ServerConnection *connection, const char *data, int length);
+int server_flush(ServerConnection *connection);
+void server_drop(ServerConnection *connection);
+void server_reply(ServerConnection *connection, const char *data, int length);
+void server_writable(ServerConnection *connection);
+void* server_io_thread(void *arg);
+void* server_accept_thread(void *arg);
+int run_server(const char *socket_path, const char* (*handler)(char *command));
+
+void server_queue_init(ServerQueue *queue) {
+    atomic_store(&queue->stub.next, NULL);
+    atomic_store(&queue->head, &queue->stub);
+    queue->tail = &queue->stub;
+}
+
+void server_queue_push(ServerQueue *queue, ServerBatch *batch) {
+    atomic_store_explicit(&batch->next, NULL, memory_order_relaxed);
+    ServerBatch *prev = atomic_exchange_explicit(&queue->head, batch, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, batch, memory_order_release);
+}
+
+ServerBatch* server_queue_pop(ServerQueue *queue) {
+    //Return the oldest batch, or NULL if the queue is empty or a push is half done
+    ServerBatch *tail = queue->tail;
+    ServerBatch *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &queue->stub) {
+        if (next == NULL) return NULL;
+        queue->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    if (next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+    if (tail != atomic_load_explicit(&queue->head, memory_order_acquire)) return NULL;
+    server_queue_push(queue, &queue->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+void server_connection_release(ServerConnection *connection) {
+    if (atomic_fetch_sub(&connection->refs, 1) == 1) {
+        close(connection->fd);
+        pthread_mutex_destroy(&connection->out_lock);
+        free(connection->out);
+        free(connection);
+    }
+}
+
+void server_connection_unlink(ServerConnection *connection) {
+    pthread_mutex_lock(&server_connections_lock);
+    if (connection->prev) connection->prev->next = connection->next;
+    else server_connections = connection->next;
+    if (connection->next) connection->next->prev = connection->prev;
+    pthread_mutex_unlock(&server_connections_lock);
+}
+
+void server_submit(ServerConnection *connection, const char *data, int length) {
+    //Split data into complete ';' or newline terminated commands and queue them as one batch.
+    //A command may grow by one byte, its ';' kept in front of the '\0'.
+    int terminators = 0;
+    int i;
+    for (i = 0; i < length; i++) {
+        if (data[i] == ';' || data[i] == '\n') terminators++;
+    }
+    ServerBatch *batch = (ServerBatch*)malloc(sizeof(ServerBatch) + length + connection->length + terminators + 1);
+    if (!batch) return;
+    batch->connection = connection;
+    batch->count = 0;
+    batch->length = 0;
+
+    for (i = 0; i < length; i++) {
+        char c = data[i];
+        if (c == ';' || c == '\n') {
+            //Skip empty commands such as the newline after a ';'
+            int start = 0;
+            while (start < connection->length && (connection->pending[start] == ' ' || connection->pending[start] == '\r')) start++;
+            if (connection->overflow) {
+                batch->text[batch->length++] = '\0';
+                batch->count++;
+            } else if (connection->length > start) {
+                memcpy(batch->text + batch->length, connection->pending + start, connection->length - start);
+                batch->length += connection->length - start;
+                if (c == ';') batch->text[batch->length++] = ';';
+                batch->text[batch->length++] = '\0';
+                batch->count++;
+            }
+            connection->length = 0;
+            connection->overflow = 0;
+        } else if (connection->length < SERVER_COMMAND_SIZE - 2) {
+            connection->pending[connection->length++] = c;
+        } else {
+            connection->overflow = 1;
+        }
+    }
+
+    if (batch->count == 0) {
+        free(batch);
+        return;
+    }
+    atomic_fetch_add(&connection->refs, 1);
+    server_queue_push(&server_queue, batch);
+    if (atomic_exchange(&server_engine_sleeping, 0)) {
+        uint64_t one = 1;
+        write(server_wakeup_fd, &one, sizeof(one));
+    }
+}
+
+int server_flush(ServerConnection *connection) {
+    //Send pending output until the socket is full, with out_lock held.
+    //Return 0 if the connection failed.
+    while (connection->out_sent < connection->out_length) {
+        ssize_t n = send(connection->fd, connection->out + connection->out_sent, connection->out_length - connection->out_sent, MSG_NOSIGNAL);
+        if (n > 0) connection->out_sent += n;
+        else if (n == -1 && errno == EINTR) continue;
+        else if (n == -1 && errno == EAGAIN) return 1;
+        else return 0;
+    }
+    connection->out_sent = connection->out_length = 0;
+    return 1;
+}
+
+void server_drop(ServerConnection *connection) {
+    //Give up on a client, with out_lock held. Shutting the socket down makes it
+    //readable, so the owning I/O thread unlinks and releases it as on EOF.
+    connection->dropped = 1;
+    connection->out_sent = connection->out_length = 0;
+    shutdown(connection->fd, SHUT_RDWR);
+}
+
+void server_reply(ServerConnection *connection, const char *data, int length) {
+    //Send what the socket takes now and keep the rest for EPOLLOUT
+    pthread_mutex_lock(&connection->out_lock);
+    if (connection->dropped) {
+        pthread_mutex_unlock(&connection->out_lock);
+        return;
+    }
+    if (connection->out_sent == connection->out_length) {
+        connection->out_sent = connection->out_length = 0;
+        while (length > 0) {
+            ssize_t n = send(connection->fd, data, length, MSG_NOSIGNAL);
+            if (n > 0) {
+                data += n;
+                length -= n;
+            } else if (n == -1 && errno == EINTR) {
+                continue;
+            } else if (n == -1 && errno == EAGAIN) {
+                break;
+            } else {
+                server_drop(connection);
+                pthread_mutex_unlock(&connection->out_lock);
+                return;
+            }
+        }
+    }
+    if (length > 0) {
+        int backlog = connection->out_length - connection->out_sent;
+        if (backlog + length > SERVER_MAX_BACKLOG) {
+            server_drop(connection);
+            pthread_mutex_unlock(&connection->out_lock);
+            return;
+        }
+        memmove(connection->out, connection->out + connection->out_sent, backlog);
+        connection->out_sent = 0;
+        connection->out_length = backlog;
+        if (backlog + length > connection->out_capacity) {
+            int capacity = connection->out_capacity ? connection->out_capacity : SERVER_COMMAND_SIZE;
+            while (capacity < backlog + length) capacity *= 2;
+            char *grown = (char*)realloc(connection->out, capacity);
+            if (!grown) {
+                server_drop(connection);
+                pthread_mutex_unlock(&connection->out_lock);
+                return;
+            }
+            connection->out = grown;
+            connection->out_capacity = capacity;
+        }
+        memcpy(connection->out + backlog, data, length);
+        connection->out_length += length;
+        if (!connection->writing) {
+            struct epoll_event event = {0};
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.ptr = connection;
+            epoll_ctl(connection->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+            connection->writing = 1;
+        }
+    }
+    pthread_mutex_unlock(&connection->out_lock);
+}
+
+void server_writable(ServerConnection *connection) {
+    //EPOLLOUT on the I/O thread: send pending output, disarm once it is all sent
+    pthread_mutex_lock(&connection->out_lock);
+    if (!connection->dropped && !server_flush(connection)) server_drop(connection);
+    if (connection->writing && connection->out_sent == connection->out_length) {
+        struct epoll_event event = {0};
+        event.events = EPOLLIN;
+        event.data.ptr = connection;
+        epoll_ctl(connection->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->writing = 0;
+    }
+    pthread_mutex_unlock(&connection->out_lock);
+}
+
+void* server_io_thread(void *arg) {
+    //Read from the connections of this worker and feed complete commands to the engine
+    ServerWorker *worker = (ServerWorker*)arg;
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    char *buffer = (char*)malloc(SERVER_READ_SIZE);
+    if (!buffer) return NULL;
+
+    while (atomic_load(&server_running)) {
+        int n = epoll_wait(worker->epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        int i;
+        for (i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) continue;    //Stop signal
+            ServerConnection *connection = (ServerConnection*)events[i].data.ptr;
+            if (events[i].events & EPOLLOUT) server_writable(connection);
+            if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) continue;
+            ssize_t length = read(connection->fd, buffer, SERVER_READ_SIZE);
+            if (length > 0) {
+                server_submit(connection, buffer, length);
+            } else if (length == 0 || (errno != EAGAIN && errno != EINTR)) {
+                epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+                server_connection_unlink(connection);
+                server_connection_release(connection);
+            }
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+void* server_accept_thread(void *arg) {
+    //Accept clients and hand them to the I/O threads round-robin
+    int epoll_fd = epoll_create1(0);
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.fd = server_listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_listen_fd, &event);
+    event.data.fd = server_stop_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_stop_fd, &event);
+
+    int next_worker = 0;
+    while (atomic_load(&server_running)) {
+        struct epoll_event ready;
+        if (epoll_wait(epoll_fd, &ready, 1, -1) <= 0 || ready.data.fd != server_listen_fd) continue;
+        int fd = accept(server_listen_fd, NULL, NULL);
+        if (fd == -1) continue;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        ServerConnection *connection = (ServerConnection*)calloc(1, sizeof(ServerConnection));
+        if (!connection) {
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->epoll_fd = server_workers[next_worker].epoll_fd;
+        pthread_mutex_init(&connection->out_lock, NULL);
+        atomic_init(&connection->refs, 1);
+        pthread_mutex_lock(&server_connections_lock);
+        connection->prev = NULL;
+        connection->next = server_connections;
+        if (server_connections) server_connections->prev = connection;
+        server_connections = connection;
+        pthread_mutex_unlock(&server_connections_lock);
+
+        struct epoll_event client = {0};
+        client.events = EPOLLIN;
+        client.data.ptr = connection;
+        epoll_ctl(connection->epoll_fd, EPOLL_CTL_ADD, fd, &client);
+        next_worker = (next_worker + 1) % SERVER_IO_THREADS;
+    }
+    close(epoll_fd);
+    (void)arg;
+    return NULL;
+}
+
+int run_server(const char *socket_path, const char* (*handler)(char *command)) {
+    //Serve booking commands on a Unix domain socket until a client sends shutdownServer.
+    //The calling thread is the only one that runs handler, in arrival order per client.
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) return 0;
+    strcpy(address.sun_path, socket_path);
+
+    server_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server_listen_fd == -1) {
+        perror("socket");
+        return 0;
+    }
+    unlink(socket_path);
+    if (bind(server_listen_fd, (struct sockaddr*)&address, sizeof(address)) == -1 || listen(server_listen_fd, SOMAXCONN) == -1) {
+        perror("bind");
+        close(server_listen_fd);
+        return 0;
+    }
+
+    server_queue_init(&server_queue);
+    server_wakeup_fd = eventfd(0, EFD_CLOEXEC);
+    server_stop_fd = eventfd(0, EFD_CLOEXEC);
+    atomic_store(&server_engine_sleeping, 0);
+    atomic_store(&server_running, 1);
+
+    int i;
+    for (i = 0; i < SERVER_IO_THREADS; i++) {
+        server_workers[i].epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event stop = {0};
+        stop.events = EPOLLIN;
+        stop.data.ptr = NULL;
+        epoll_ctl(server_workers[i].epoll_fd, EPOLL_CTL_ADD, server_stop_fd, &stop);
+        pthread_create(&server_workers[i].thread, NULL, server_io_thread, &server_workers[i]);
+    }
+    pthread_t acceptor;
+    pthread_create(&acceptor, NULL, server_accept_thread, NULL);
+
+    //Engine loop: drain batches, execute every command, send one reply per batch
+    char *reply = (char*)malloc(SERVER_READ_SIZE);
+    int reply_capacity = SERVER_READ_SIZE;
+    while (atomic_load(&server_running)) {
+        ServerBatch *batch = server_queue_pop(&server_queue);
+        if (batch == NULL) {
+            atomic_store(&server_engine_sleeping, 1);
+            batch = server_queue_pop(&server_queue);
+            if (batch == NULL) {
+                uint64_t value;
+                read(server_wakeup_fd, &value, sizeof(value));
+                continue;
+            }
+            atomic_store(&server_engine_sleeping, 0);
+        }
+
+        int reply_length = 0;
+        char *command = batch->text;
+        int c;
+        for (c = 0; c < batch->count; c++) {
+            int command_length = strlen(command);
+            const char *result;
+            if (command_length == 0) {
+                result = SERVER_TOO_LONG_REPLY;
+            } else if (strncmp(command, SERVER_SHUTDOWN_COMMAND, strlen(SERVER_SHUTDOWN_COMMAND)) == 0) {
+                atomic_store(&server_running, 0);
+                result = "BYE";
+            } else {
+                result = handler(command);
+            }
+            int result_length = strlen(result);
+            if (reply_length + result_length + 1 > reply_capacity) {
+                char *grown = (char*)realloc(reply, reply_capacity * 2);
+                if (grown) {
+                    reply = grown;
+                    reply_capacity *= 2;
+                }
+            }
+            if (reply_length + result_length + 1 <= reply_capacity) {
+                memcpy(reply + reply_length, result, result_length);
+                reply_length += result_length;
+                reply[reply_length++] = '\n';
+            }
+            command += command_length + 1;
+        }
+
+        //Bookings of the batch become durable before the client sees the reply
+        wal_commit();
+        server_reply(batch->connection, reply, reply_length);
+        server_connection_release(batch->connection);
+        free(batch);
+    }
+    free(reply);
+
+    //Wake every thread blocked in epoll_wait and wait for them to finish
+    uint64_t one = 1;
+    write(server_stop_fd, &one, sizeof(one));
+    pthread_join(acceptor, NULL);
+    for (i = 0; i < SERVER_IO_THREADS; i++) {
+        pthread_join(server_workers[i].thread, NULL);
+        close(server_workers[i].epoll_fd);
+    }
+
+    //Batches queued after shutdown are dropped, then remaining clients are disconnected
+    ServerBatch *batch;
+    while ((batch = server_queue_pop(&server_queue)) != NULL) {
+        server_connection_release(batch->connection);
+        free(batch);
+    }
+    while (server_connections != NULL) {
+        ServerConnection *connection = server_connections;
+        server_connections = connection->next;
+        server_connection_release(connection);
+    }
+    close(server_listen_fd);
+    close(server_wakeup_fd);
+    close(server_stop_fd);
+    unlink(socket_path);
+    return 1;
+}
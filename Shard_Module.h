@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "node.h"
+
+#define SHARD_BY_SITE 0
+#define SHARD_BY_DATE 1
+#define SHARD_MAX_WORKERS 64
+
+//A shard key is a site, or a site and a group of days that no booking
+//crosses. FCFS decisions of different keys never interact, so every key can
+//be scheduled by a different process without any per-booking messages.
+typedef struct {
+    int booking_num;
+    int key_num;
+    int *key_start;     //Bookings of key k are order[key_start[k] .. key_start[k + 1] - 1]
+    int *order;         //Booking indexes grouped by key, in stream order within a key
+    int *key_site;
+    int *key_worker;
+} ShardPlan;
+
+int shard_plan(ShardPlan *plan, const Booking *bookings, int n, int mode, int worker_num, unsigned char *decision);
+void shard_plan_free(ShardPlan *plan);
+void shard_worker(const ShardPlan *plan, const Booking *bookings, int worker, unsigned char *decision);
+int shard_schedule(const Booking *bookings, int n, int mode, int worker_num, unsigned char *decision);
+
+int shard_plan(ShardPlan *plan, const Booking *bookings, int n, int mode, int worker_num, unsigned char *decision) {
+    //Key every booking and spread the keys over the workers, return 0 on failure.
+    //Bookings outside the testing period are decided here and get no key.
+    int key_num = mode == SHARD_BY_DATE ? site_count * TESTING_DAY : site_count;
+    int *key = (int*)malloc((n + 1) * sizeof(int));
+    int *reach = (int*)malloc((site_count * TESTING_DAY + 1) * sizeof(int));
+    memset(plan, 0, sizeof(ShardPlan));
+    plan->booking_num = n;
+    plan->key_num = key_num;
+    plan->key_start = (int*)calloc(key_num + 1, sizeof(int));
+    plan->order = (int*)malloc((n + 1) * sizeof(int));
+    plan->key_site = (int*)malloc((key_num + 1) * sizeof(int));
+    plan->key_worker = (int*)malloc((key_num + 1) * sizeof(int));
+    if (!key || !reach || !plan->key_start || !plan->order || !plan->key_site || !plan->key_worker) {
+        free(key);
+        free(reach);
+        shard_plan_free(plan);
+        return 0;
+    }
+
+    //reach[site][day] is the last day touched by a booking starting on that day
+    int i, k, day;
+    for (i = 0; i < site_count * TESTING_DAY; i++) reach[i] = i % TESTING_DAY;
+    for (i = 0; i < n; i++) {
+        int start_day, end_day, start_slot, end_slot;
+        int site = bookings[i].site_id;
+        if (site < 0 || site >= site_count || !booking_slot_range(&bookings[i], &start_day, &end_day, &start_slot, &end_slot)) {
+            decision[i] = ADMIT_OUT_OF_RANGE;
+            key[i] = -1;
+            continue;
+        }
+        //An end slot of 24:00 is slot 0 of the next day, except on the last day (spare slot)
+        if (end_slot == TIME_SLOT_PER_DAY && end_day < TESTING_DAY - 1) end_day++;
+        if (end_day > reach[site * TESTING_DAY + start_day]) reach[site * TESTING_DAY + start_day] = end_day;
+        key[i] = mode == SHARD_BY_DATE ? site * TESTING_DAY + start_day : site;
+    }
+    if (mode == SHARD_BY_DATE) {
+        //Days linked by a booking across midnight form one group, keyed by its first day
+        int site;
+        for (site = 0; site < site_count; site++) {
+            int group = 0, group_end = -1;
+            for (day = 0; day < TESTING_DAY; day++) {
+                if (day > group_end) group = day;
+                if (reach[site * TESTING_DAY + day] > group_end) group_end = reach[site * TESTING_DAY + day];
+                reach[site * TESTING_DAY + day] = group;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            if (key[i] >= 0) key[i] = key[i] - key[i] % TESTING_DAY + reach[key[i]];
+        }
+    }
+
+    //Counting sort keeps stream order inside every key
+    for (i = 0; i < n; i++) {
+        if (key[i] >= 0) plan->key_start[key[i] + 1]++;
+    }
+    for (k = 0; k < key_num; k++) plan->key_start[k + 1] += plan->key_start[k];
+    int *fill = reach;     //No longer needed, and key_num <= site_count * TESTING_DAY
+    memcpy(fill, plan->key_start, key_num * sizeof(int));
+    for (i = 0; i < n; i++) {
+        if (key[i] >= 0) plan->order[fill[key[i]]++] = i;
+    }
+
+    //Greedy balance: every key goes to the worker with the fewest bookings so far
+    int load[SHARD_MAX_WORKERS] = {0};
+    for (k = 0; k < key_num; k++) {
+        int w, best = 0;
+        for (w = 1; w < worker_num; w++) {
+            if (load[w] < load[best]) best = w;
+        }
+        plan->key_site[k] = mode == SHARD_BY_DATE ? k / TESTING_DAY : k;
+        plan->key_worker[k] = best;
+        load[best] += plan->key_start[k + 1] - plan->key_start[k];
+    }
+    free(key);
+    free(reach);
+    return 1;
+}
+
+void shard_plan_free(ShardPlan *plan) {
+    free(plan->key_start);
+    free(plan->order);
+    free(plan->key_site);
+    free(plan->key_worker);
+    memset(plan, 0, sizeof(ShardPlan));
+}
+
+void shard_worker(const ShardPlan *plan, const Booking *bookings, int worker, unsigned char *decision) {
+    //FCFS for every key of this worker, one private slot index per key
+    int k, i;
+    for (k = 0; k < plan->key_num; k++) {
+        if (plan->key_worker[k] != worker || plan->key_start[k] == plan->key_start[k + 1]) continue;
+        SlotIndex index;
+        if (!slot_index_init(&index, sites[plan->key_site[k]].capacity)) continue;
+        for (i = plan->key_start[k]; i < plan->key_start[k + 1]; i++) {
+            int b = plan->order[i];
+            decision[b] = admit_booking(&index, &bookings[b], NULL);
+        }
+        slot_index_free(&index);
+    }
+}
+
+int shard_schedule(const Booking *bookings, int n, int mode, int worker_num, unsigned char *decision) {
+    //Schedule the booking stream with worker_num forked processes. Workers write
+    //one ADMIT_* code per booking into a shared mapping, which is copied to
+    //decision in stream order. Return 0 if a worker failed.
+    if (worker_num < 1) worker_num = 1;
+    if (worker_num > SHARD_MAX_WORKERS) worker_num = SHARD_MAX_WORKERS;
+    unsigned char *shared = (unsigned char*)mmap(NULL, n + 1, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) return 0;
+    memset(shared, 0, n + 1);
+
+    ShardPlan plan;
+    if (!shard_plan(&plan, bookings, n, mode, worker_num, shared)) {
+        munmap(shared, n + 1);
+        return 0;
+    }
+
+    pid_t pids[SHARD_MAX_WORKERS];
+    int w, ok = 1;
+    fflush(stdout);     //Children must not flush the parent's pending output again
+    for (w = 0; w < worker_num; w++) {
+        pids[w] = fork();
+        if (pids[w] == 0) {
+            shard_worker(&plan, bookings, w, shared);
+            _exit(0);
+        }
+        if (pids[w] == -1) {
+            //No process for this shard, schedule it here instead
+            perror("fork");
+            shard_worker(&plan, bookings, w, shared);
+        }
+    }
+    for (w = 0; w < worker_num; w++) {
+        int status;
+        if (pids[w] == -1) continue;
+        if (waitpid(pids[w], &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = 0;
+    }
+
+    //Every keyed booking must have been decided by its worker
+    int i;
+    for (i = 0; i < n; i++) {
+        if (shared[i] == 0) ok = 0;
+    }
+    memcpy(decision, shared, n);
+    munmap(shared, n + 1);
+    shard_plan_free(&plan);
+    return ok;
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "node.h"
+
+#define SITE_FILE "sites.dat"
+#define SITE_NAME_LEN 64
+#define DEFAULT_SITE_NAME "main"
+
+//A site is one car park with its own capacities and booking store. Slot state
+//only exists while a site is being scheduled, so an idle site costs one Site.
+typedef struct {
+    char name[SITE_NAME_LEN];
+    int capacity[RESOURCE_NUM];
+    Node *head;
+    Node *tail;
+} Site;
+
+//FCFS outcome of one site
+typedef struct {
+    int booking_num;
+    int accepted_num;
+    int rejected_num;
+    int invalid_num;
+    int failed;         //Slot index could not be allocated
+} SiteResult;
+
+typedef struct {
+    SiteResult *results;
+    atomic_int next_site;
+} SiteScheduleJob;
+
+Site *sites = NULL;
+int site_count = 0;
+int site_allocated = 0;
+int current_site = 0;   //Site whose store is in head/tail of main.c
+
+int site_register(const char *name, const int capacity[RESOURCE_NUM]);
+int site_lookup(const char *name);
+int site_resolve(const char *name);
+const char* site_name(int site_id);
+void site_append(int site_id, Node *node);
+int load_site_file(const char *filename);
+int save_site_file(const char *filename);
+void schedule_site(const Site *site, SiteResult *result);
+void* schedule_sites_thread(void *arg);
+int schedule_sites(SiteResult *results);
+
+int site_register(const char *name, const int capacity[RESOURCE_NUM]) {
+    //Add a site or redefine the capacities of an existing one, return its id or -1
+    int id = site_lookup(name);
+    if (id < 0) {
+        if (strlen(name) == 0 || strlen(name) >= SITE_NAME_LEN) return -1;
+        if (site_count == site_allocated) {
+            int allocated = site_allocated ? site_allocated * 2 : 16;
+            Site *grown = (Site*)realloc(sites, allocated * sizeof(Site));
+            if (!grown) {
+                perror("realloc");
+                return -1;
+            }
+            sites = grown;
+            site_allocated = allocated;
+        }
+        id = site_count++;
+        memset(&sites[id], 0, sizeof(Site));
+        strcpy(sites[id].name, name);
+    }
+    memcpy(sites[id].capacity, capacity, sizeof(sites[id].capacity));
+    return id;
+}
+
+int site_lookup(const char *name) {
+    //Return the id of name, or -1 if no such site
+    int id;
+    for (id = 0; id < site_count; id++) {
+        if (strcmp(sites[id].name, name) == 0) return id;
+    }
+    return -1;
+}
+
+int site_resolve(const char *name) {
+    //Id of the site called name, registered with the catalog capacities if it
+    //is new, or -1. Stored bookings name their site so they survive a registry change.
+    int id = site_lookup(name);
+    if (id >= 0) return id;
+    int capacity[RESOURCE_NUM];
+    catalog_capacities(capacity);
+    return site_register(name, capacity);
+}
+
+const char* site_name(int site_id) {
+    if (site_id < 0 || site_id >= site_count) return "unknown";
+    return sites[site_id].name;
+}
+
+void site_append(int site_id, Node *node) {
+    //Append to the store of a site that is not the current one. Bookings of a
+    //site missing from the registry get a placeholder site with default capacities.
+    int capacity[RESOURCE_NUM];
+    catalog_capacities(capacity);
+    if (site_id < 0) site_id = 0;
+    while (site_id >= site_count) {
+        char name[SITE_NAME_LEN];
+        snprintf(name, sizeof(name), "site_%d", site_count);
+        if (site_register(name, capacity) < 0) return;
+    }
+    Site *site = &sites[site_id];
+    node->next = NULL;
+    if (site->head == NULL) site->head = node;
+    else site->tail->next = node;
+    site->tail = node;
+}
+
+int load_site_file(const char *filename) {
+    //One site per line: name followed by up to one capacity per resource in
+    //catalog order, missing ones take the defaults. Return sites loaded or -1.
+    FILE *file = fopen(filename, "r");
+    if (!file) return -1;
+
+    char line[256];
+    int loaded = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        int capacity[RESOURCE_NUM];
+        catalog_capacities(capacity);
+        char *name = strtok(line, " \t\r\n;");
+        if (name == NULL || name[0] == '#') continue;
+        int r;
+        for (r = 0; r < resource_count; r++) {
+            char *value = strtok(NULL, " \t\r\n;");
+            if (value == NULL) break;
+            capacity[r] = atoi(value);
+        }
+        if (site_register(name, capacity) >= 0) loaded++;
+    }
+    fclose(file);
+    return loaded;
+}
+
+int save_site_file(const char *filename) {
+    //Write the registry in load_site_file format so site ids survive a restart
+    FILE *file = fopen(filename, "w");
+    if (!file) return 0;
+    int id, r;
+    for (id = 0; id < site_count; id++) {
+        fprintf(file, "%s", sites[id].name);
+        for (r = 0; r < resource_count; r++) fprintf(file, " %d", sites[id].capacity[r]);
+        fprintf(file, "\n");
+    }
+    return fclose(file) == 0;
+}
+
+void schedule_site(const Site *site, SiteResult *result) {
+    //FCFS over the site's own slot index, same decisions as the FCFS policy of run_schedule
+    memset(result, 0, sizeof(SiteResult));
+    if (site->head == NULL) return;
+
+    SlotIndex index;
+    if (!slot_index_init(&index, site->capacity)) {
+        result->failed = 1;
+        return;
+    }
+    Node *current;
+    for (current = site->head; current != NULL; current = current->next) {
+        result->booking_num++;
+        switch (admit_booking(&index, &current->booking, NULL)) {
+            case ADMIT_ACCEPTED: result->accepted_num++; break;
+            case ADMIT_REJECTED: result->rejected_num++; break;
+            default: result->invalid_num++; break;
+        }
+    }
+    slot_index_free(&index);
+}
+
+void* schedule_sites_thread(void *arg) {
+    //Sites share no state, so workers just take the next unscheduled one
+    SiteScheduleJob *job = (SiteScheduleJob*)arg;
+    while (1) {
+        int id = atomic_fetch_add(&job->next_site, 1);
+        if (id >= site_count) break;
+        schedule_site(&sites[id], &job->results[id]);
+    }
+    return NULL;
+}
+
+int schedule_sites(SiteResult *results) {
+    //Schedule every site in parallel, one worker per online CPU, return workers used
+    SiteScheduleJob job;
+    job.results = results;
+    atomic_init(&job.next_site, 0);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int thread_num = cpus < 1 ? 1 : (int)cpus;
+    if (thread_num > site_count) thread_num = site_count;
+    if (thread_num <= 1) {
+        schedule_sites_thread(&job);
+        return 1;
+    }
+
+    pthread_t *threads = (pthread_t*)malloc((thread_num - 1) * sizeof(pthread_t));
+    if (!threads) {
+        schedule_sites_thread(&job);
+        return 1;
+    }
+    int i, started = 0;
+    for (i = 0; i < thread_num - 1; i++) {
+        if (pthread_create(&threads[i], NULL, schedule_sites_thread, &job) != 0) break;
+        started++;
+    }
+    //Also work on the calling thread, which covers a failed pthread_create
+    schedule_sites_thread(&job);
+    for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    free(threads);
+    return started + 1;
+}
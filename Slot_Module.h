@@ -0,0 +1,772 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "node.h"
+
+//Every unit of a resource owns one bit per time slot of the testing period,
+//laid out day after day, plus one spare bit for a booking ending exactly at
+//midnight of the last day (the schedulers treat the end slot as inclusive).
+#define SLOT_HORIZON (TESTING_DAY*TIME_SLOT_PER_DAY + 1)
+#define SLOT_WORDS_PER_UNIT ((SLOT_HORIZON + 63) / 64)
+
+#define ADMIT_ACCEPTED 1
+#define ADMIT_REJECTED 2
+#define ADMIT_OUT_OF_RANGE 3
+
+//Unit placement policies of the resource managers and online admission
+#define PLACEMENT_FIRST_FIT 0   //Lowest unit free over the range
+#define PLACEMENT_BEST_FIT 1    //Unit leaving the shortest free run around the range
+#define PLACEMENT_DAY_PACK 2    //Unit already busiest on the days of the range
+#define PLACEMENT_NUM 3
+
+int placement_policy = PLACEMENT_FIRST_FIT;
+const char* PLACEMENT_NAMES[PLACEMENT_NUM] = {"first-fit", "best-fit", "day-pack"};
+
+//Occupancy words are updated with atomic operations only: a claim sets the bits
+//of a slot range word by word with compare-and-swap and rolls back the words it
+//already set if a later one is taken, so concurrent admissions never take a lock.
+typedef _Atomic uint64_t SlotWord;
+
+//Group bookings (addEvent with quantities) hold count units of a resource,
+//any count units free over their range. Free units are found in a slot-major
+//copy of the occupancy, one row of unit bits per slot: OR-ing the rows of a
+//range gives the busy units over the whole range at once, so "are k units
+//free" costs the rows of the range, not a scan of every unit. The unit-major
+//bits stay authoritative for claims.
+typedef struct {
+    int capacity[RESOURCE_NUM];
+    SlotWord *bits[RESOURCE_NUM];       //capacity[r] * SLOT_WORDS_PER_UNIT words
+    SlotWord *columns[RESOURCE_NUM];    //SLOT_HORIZON rows of slot_column_words(capacity[r]) words
+} SlotIndex;
+
+//Units of one group, bit u % 64 of bits[u / 64] for unit u
+typedef struct {
+    int words;
+    uint64_t bits[];
+} SlotUnitSet;
+
+//Units a booking holds in a SlotIndex. A group takes a block of adjacent
+//units when there is one and any free units otherwise, so it also keeps the
+//set of all of them; a single unit needs no set.
+typedef struct {
+    int unit[RESOURCE_NUM];             //Lowest unit held of every resource, -1 if none
+    SlotUnitSet *group[RESOURCE_NUM];   //Every unit of a group, NULL otherwise
+} SlotUnits;
+
+int booking_slot_range(const Booking* booking, int* start_day, int* end_day, int* start_slot, int* end_slot);
+unsigned int resource_mask(const Booking* booking);
+void resource_counts(const Booking* booking, int counts[RESOURCE_NUM]);
+int slot_index_init(SlotIndex *index, const int capacity[RESOURCE_NUM]);
+void slot_index_free(SlotIndex *index);
+int slot_index_grow(SlotIndex *index, const int capacity[RESOURCE_NUM]);
+uint64_t slot_word_mask(int word, int first, int last);
+int slot_range_free(SlotWord *unit, int first, int last);
+void slot_range_set(SlotWord *unit, int first, int last);
+void slot_range_clear(SlotWord *unit, int first, int last);
+int slot_range_claim(SlotWord *unit, int first, int last);
+SlotWord* slot_unit(const SlotIndex *index, int resource, int unit);
+void slot_units_init(SlotUnits *units);
+void slot_units_free(SlotUnits *units);
+unsigned int slot_units_scattered(const SlotUnits *units);
+void slot_units_mark(SlotIndex *index, const SlotUnits *units, int first, int last, int busy);
+void slot_release_units(SlotIndex *index, const SlotUnits *units, int first, int last);
+int slot_column_words(int capacity);
+int slot_columns_choose(SlotWord *columns, int capacity, int first, int last, int count, uint64_t *chosen);
+int slot_set_adjacent(const uint64_t *set, int words);
+void slot_columns_mark(SlotWord *columns, int capacity, int unit, int count, int first, int last, int busy);
+void slot_columns_mark_set(SlotWord *columns, int capacity, const uint64_t *set, int words, int first, int last, int busy);
+int slot_claim_set(SlotIndex *index, int resource, const uint64_t *set, int words, int first, int last);
+void slot_mask_counts(unsigned int mask, int counts[RESOURCE_NUM]);
+int slot_find_unit(const SlotIndex *index, int resource, int first, int last);
+int slot_free_gap(SlotWord *unit, int first, int last);
+int slot_busy_count(SlotWord *unit, int first, int last);
+int slot_place_unit(SlotWord *units, int capacity, int first, int last, int policy);
+int slot_reserve(SlotIndex *index, unsigned int mask, int first, int last, SlotUnits *units);
+int slot_reserve_counts(SlotIndex *index, const int counts[RESOURCE_NUM], int first, int last, SlotUnits *units);
+int admit_booking(SlotIndex *index, const Booking *booking, SlotUnits *units);
+void release_booking(SlotIndex *index, const Booking *booking, const SlotUnits *units);
+void retake_booking(SlotIndex *index, const Booking *booking, const SlotUnits *units);
+void* slot_stress_thread(void *arg);
+int slot_stress_test(int thread_num, int iterations);
+void* slot_benchmark_thread(void *arg);
+void slot_benchmark(int max_threads);
+void placement_benchmark(int requests, int rounds);
+
+int slot_index_init(SlotIndex *index, const int capacity[RESOURCE_NUM]) {
+    //Allocate an empty index, return 0 on failure
+    int r;
+    memset(index, 0, sizeof(SlotIndex));
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        index->capacity[r] = capacity[r];
+        index->bits[r] = (SlotWord*)calloc((size_t)capacity[r] * SLOT_WORDS_PER_UNIT + 1, sizeof(SlotWord));
+        index->columns[r] = (SlotWord*)calloc((size_t)SLOT_HORIZON * slot_column_words(capacity[r]) + 1, sizeof(SlotWord));
+        if (!index->bits[r] || !index->columns[r]) {
+            slot_index_free(index);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void slot_index_free(SlotIndex *index) {
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        free(index->bits[r]);
+        free(index->columns[r]);
+        index->bits[r] = NULL;
+        index->columns[r] = NULL;
+    }
+}
+
+int slot_index_grow(SlotIndex *index, const int capacity[RESOURCE_NUM]) {
+    //Add empty units up to capacity, keeping every claim. Return 0 and leave
+    //the index unchanged if some capacity shrinks, since that needs a rebuild,
+    //or if memory runs out: every buffer is built before any is swapped in.
+    SlotWord *bits[RESOURCE_NUM] = {NULL}, *columns[RESOURCE_NUM] = {NULL};
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (capacity[r] < index->capacity[r]) return 0;
+    }
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (capacity[r] == index->capacity[r]) continue;
+        size_t old_words = (size_t)index->capacity[r] * SLOT_WORDS_PER_UNIT;
+        size_t words = (size_t)capacity[r] * SLOT_WORDS_PER_UNIT;
+        size_t word;
+        bits[r] = (SlotWord*)calloc(words + 1, sizeof(SlotWord));
+        if (!bits[r]) break;
+        for (word = 0; word < old_words; word++) atomic_init(&bits[r][word], atomic_load(&index->bits[r][word]));
+
+        //Rows get wider, so the slot-major copy is laid out again
+        int old_row = slot_column_words(index->capacity[r]), row = slot_column_words(capacity[r]);
+        if (row == old_row) continue;
+        columns[r] = (SlotWord*)calloc((size_t)SLOT_HORIZON * row + 1, sizeof(SlotWord));
+        if (!columns[r]) break;
+        int slot, column;
+        for (slot = 0; slot < SLOT_HORIZON; slot++) {
+            for (column = 0; column < old_row; column++) {
+                atomic_init(&columns[r][(size_t)slot * row + column], atomic_load(&index->columns[r][(size_t)slot * old_row + column]));
+            }
+        }
+    }
+    if (r < RESOURCE_NUM) {
+        for (r = 0; r < RESOURCE_NUM; r++) {
+            free(bits[r]);
+            free(columns[r]);
+        }
+        return 0;
+    }
+
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (capacity[r] == index->capacity[r]) continue;
+        free(index->bits[r]);
+        index->bits[r] = bits[r];
+        if (columns[r]) {
+            free(index->columns[r]);
+            index->columns[r] = columns[r];
+        }
+        index->capacity[r] = capacity[r];
+    }
+    return 1;
+}
+
+uint64_t slot_word_mask(int word, int first, int last) {
+    //Bits of word covered by the inclusive slot range [first, last]
+    int low = first - word * 64;
+    int high = last - word * 64;
+    if (low < 0) low = 0;
+    if (high > 63) high = 63;
+    if (low > high) return 0;
+    uint64_t upper = (high == 63) ? ~0ULL : ((1ULL << (high + 1)) - 1);
+    return upper & ~((1ULL << low) - 1);
+}
+
+SlotWord* slot_unit(const SlotIndex *index, int resource, int unit) {
+    return index->bits[resource] + (size_t)unit * SLOT_WORDS_PER_UNIT;
+}
+
+int slot_range_free(SlotWord *unit, int first, int last) {
+    int word;
+    for (word = first / 64; word <= last / 64; word++) {
+        if (atomic_load_explicit(&unit[word], memory_order_acquire) & slot_word_mask(word, first, last)) return 0;
+    }
+    return 1;
+}
+
+void slot_range_set(SlotWord *unit, int first, int last) {
+    int word;
+    for (word = first / 64; word <= last / 64; word++) {
+        atomic_fetch_or_explicit(&unit[word], slot_word_mask(word, first, last), memory_order_acq_rel);
+    }
+}
+
+void slot_range_clear(SlotWord *unit, int first, int last) {
+    int word;
+    for (word = first / 64; word <= last / 64; word++) {
+        atomic_fetch_and_explicit(&unit[word], ~slot_word_mask(word, first, last), memory_order_acq_rel);
+    }
+}
+
+int slot_range_claim(SlotWord *unit, int first, int last) {
+    //Set every bit of [first, last] if all of them are clear, return 0 and leave
+    //the unit unchanged otherwise
+    int word;
+    for (word = first / 64; word <= last / 64; word++) {
+        uint64_t mask = slot_word_mask(word, first, last);
+        uint64_t old = atomic_load_explicit(&unit[word], memory_order_relaxed);
+        do {
+            if (old & mask) {
+                //Roll back the words claimed so far
+                while (--word >= first / 64) {
+                    atomic_fetch_and_explicit(&unit[word], ~slot_word_mask(word, first, last), memory_order_release);
+                }
+                return 0;
+            }
+        } while (!atomic_compare_exchange_weak_explicit(&unit[word], &old, old | mask, memory_order_acq_rel, memory_order_relaxed));
+    }
+    return 1;
+}
+
+int slot_find_unit(const SlotIndex *index, int resource, int first, int last) {
+    //Unit of resource free over [first, last] that resource_manager would pick, or -1
+    return slot_place_unit(index->bits[resource], index->capacity[resource], first, last, placement_policy);
+}
+
+int slot_free_gap(SlotWord *unit, int first, int last) {
+    //Free slots left on both sides of [first, last] in the free run holding it
+    int prev = -1, next = SLOT_HORIZON, pos;
+    for (pos = first - 1; pos >= 0; pos -= pos % 64 + 1) {
+        uint64_t bits = atomic_load_explicit(&unit[pos / 64], memory_order_relaxed) & slot_word_mask(0, 0, pos % 64);
+        if (bits) {
+            prev = pos / 64 * 64 + 63 - __builtin_clzll(bits);
+            break;
+        }
+    }
+    for (pos = last + 1; pos < SLOT_HORIZON; pos += 64 - pos % 64) {
+        uint64_t bits = atomic_load_explicit(&unit[pos / 64], memory_order_relaxed) >> (pos % 64);
+        if (bits) {
+            next = pos + __builtin_ctzll(bits);
+            break;
+        }
+    }
+    return (first - prev - 1) + (next - last - 1);
+}
+
+int slot_busy_count(SlotWord *unit, int first, int last) {
+    int word, busy = 0;
+    for (word = first / 64; word <= last / 64; word++) {
+        busy += __builtin_popcountll(atomic_load_explicit(&unit[word], memory_order_relaxed) & slot_word_mask(word, first, last));
+    }
+    return busy;
+}
+
+int slot_place_unit(SlotWord *units, int capacity, int first, int last, int policy) {
+    //Unit free over [first, last] among capacity units laid out one after
+    //another, chosen by policy with ties going to the lowest unit; -1 if none.
+    //Best-fit keeps long free runs whole for long bookings, day-pack fills
+    //units that are already in use that day and leaves the others empty.
+    int day_first = first / TIME_SLOT_PER_DAY * TIME_SLOT_PER_DAY;
+    int day_last = (last / TIME_SLOT_PER_DAY + 1) * TIME_SLOT_PER_DAY - 1;
+    if (day_last >= SLOT_HORIZON) day_last = SLOT_HORIZON - 1;
+    int unit, best = -1, best_score = 0;
+    for (unit = 0; unit < capacity; unit++) {
+        SlotWord *words = units + (size_t)unit * SLOT_WORDS_PER_UNIT;
+        if (!slot_range_free(words, first, last)) continue;
+        if (policy == PLACEMENT_FIRST_FIT) return unit;
+        int score = policy == PLACEMENT_BEST_FIT ? -slot_free_gap(words, first, last) : slot_busy_count(words, day_first, day_last);
+        if (best < 0 || score > best_score) {
+            best = unit;
+            best_score = score;
+        }
+        if (policy == PLACEMENT_BEST_FIT && score == 0) break;     //Exact fit
+    }
+    return best;
+}
+
+void slot_units_init(SlotUnits *units) {
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        units->unit[r] = -1;
+        units->group[r] = NULL;
+    }
+}
+
+void slot_units_free(SlotUnits *units) {
+    //Free the sets of every group and hold nothing
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) free(units->group[r]);
+    slot_units_init(units);
+}
+
+unsigned int slot_units_scattered(const SlotUnits *units) {
+    //Resources of which a group holds units that are not adjacent
+    unsigned int mask = 0;
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (units->group[r] && !slot_set_adjacent(units->group[r]->bits, units->group[r]->words)) mask |= 1u << r;
+    }
+    return mask;
+}
+
+void slot_units_mark(SlotIndex *index, const SlotUnits *units, int first, int last, int busy) {
+    //Set (busy) or clear [first, last] on every unit held, in both layouts
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (units->unit[r] < 0) continue;
+        const SlotUnitSet *set = units->group[r];
+        if (!set) {
+            if (busy) slot_range_set(slot_unit(index, r, units->unit[r]), first, last);
+            else slot_range_clear(slot_unit(index, r, units->unit[r]), first, last);
+            slot_columns_mark(index->columns[r], index->capacity[r], units->unit[r], 1, first, last, busy);
+            continue;
+        }
+        int word;
+        for (word = 0; word < set->words; word++) {
+            uint64_t bits = set->bits[word];
+            while (bits) {
+                int unit = word * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (busy) slot_range_set(slot_unit(index, r, unit), first, last);
+                else slot_range_clear(slot_unit(index, r, unit), first, last);
+            }
+        }
+        slot_columns_mark_set(index->columns[r], index->capacity[r], set->bits, set->words, first, last, busy);
+    }
+}
+
+void slot_release_units(SlotIndex *index, const SlotUnits *units, int first, int last) {
+    //Clear every unit held of every resource
+    slot_units_mark(index, units, first, last, 0);
+}
+
+int slot_column_words(int capacity) {
+    return (capacity + 63) / 64;
+}
+
+int slot_columns_choose(SlotWord *columns, int capacity, int first, int last, int count, uint64_t *chosen) {
+    //Pick count units free over [first, last] into chosen, slot_column_words(capacity)
+    //words: the first block of count adjacent free units, or else the lowest
+    //count free units. Return the lowest unit picked, or -1 if fewer are free.
+    int row = slot_column_words(capacity);
+    uint64_t stack_free[64];
+    uint64_t *free_units = row <= 64 ? stack_free : (uint64_t*)malloc(row * sizeof(uint64_t));
+    if (!free_units) return -1;
+    int word, slot, total = 0;
+    for (word = 0; word < row; word++) free_units[word] = slot_word_mask(word, 0, capacity - 1);
+    for (slot = first; slot <= last; slot++) {
+        SlotWord *busy = columns + (size_t)slot * row;
+        for (word = 0; word < row; word++) free_units[word] &= ~atomic_load_explicit(&busy[word], memory_order_relaxed);
+    }
+    for (word = 0; word < row; word++) total += __builtin_popcountll(free_units[word]);
+    memset(chosen, 0, row * sizeof(uint64_t));
+    if (total < count || count <= 0) {
+        if (free_units != stack_free) free(free_units);
+        return -1;
+    }
+
+    //Adjacent units first, so a group stays together whenever it can
+    int found = -1, run = 0, start = 0;
+    for (word = 0; word < row && found < 0; word++) {
+        uint64_t bits = free_units[word];
+        if (bits == ~0ULL) {
+            if (run == 0) start = word * 64;
+            run += 64;
+            if (run >= count) found = start;
+            continue;
+        }
+        int bit;
+        for (bit = 0; bit < 64; bit++) {
+            if (bits >> bit & 1) {
+                if (run == 0) start = word * 64 + bit;
+                if (++run >= count) {
+                    found = start;
+                    break;
+                }
+            } else {
+                run = 0;
+            }
+        }
+    }
+    if (found >= 0) {
+        for (word = found / 64; word <= (found + count - 1) / 64; word++) chosen[word] = slot_word_mask(word, found, found + count - 1);
+    } else {
+        int left = count;
+        for (word = 0; word < row && left > 0; word++) {
+            uint64_t bits = free_units[word];
+            while (bits && left > 0) {
+                if (found < 0) found = word * 64 + __builtin_ctzll(bits);
+                chosen[word] |= bits & -bits;
+                bits &= bits - 1;
+                left--;
+            }
+        }
+    }
+    if (free_units != stack_free) free(free_units);
+    return found;
+}
+
+int slot_set_adjacent(const uint64_t *set, int words) {
+    //Whether the units of set form one block
+    int word, lowest = -1, highest = -1, total = 0;
+    for (word = 0; word < words; word++) {
+        if (!set[word]) continue;
+        if (lowest < 0) lowest = word * 64 + __builtin_ctzll(set[word]);
+        highest = word * 64 + 63 - __builtin_clzll(set[word]);
+        total += __builtin_popcountll(set[word]);
+    }
+    return total == 0 || highest - lowest + 1 == total;
+}
+
+void slot_columns_mark(SlotWord *columns, int capacity, int unit, int count, int first, int last, int busy) {
+    //Set (busy) or clear the bits of units [unit, unit + count) in the rows of [first, last]
+    int row = slot_column_words(capacity);
+    int slot, word;
+    for (slot = first; slot <= last; slot++) {
+        SlotWord *units = columns + (size_t)slot * row;
+        for (word = unit / 64; word <= (unit + count - 1) / 64; word++) {
+            uint64_t mask = slot_word_mask(word, unit, unit + count - 1);
+            if (busy) atomic_fetch_or_explicit(&units[word], mask, memory_order_relaxed);
+            else atomic_fetch_and_explicit(&units[word], ~mask, memory_order_relaxed);
+        }
+    }
+}
+
+void slot_columns_mark_set(SlotWord *columns, int capacity, const uint64_t *set, int words, int first, int last, int busy) {
+    //Set (busy) or clear the bits of the units in set in the rows of [first, last]
+    int row = slot_column_words(capacity);
+    int slot, word;
+    for (slot = first; slot <= last; slot++) {
+        SlotWord *units = columns + (size_t)slot * row;
+        for (word = 0; word < words && word < row; word++) {
+            if (!set[word]) continue;
+            if (busy) atomic_fetch_or_explicit(&units[word], set[word], memory_order_relaxed);
+            else atomic_fetch_and_explicit(&units[word], ~set[word], memory_order_relaxed);
+        }
+    }
+}
+
+int slot_claim_set(SlotIndex *index, int resource, const uint64_t *set, int words, int first, int last) {
+    //Claim [first, last] on every unit in set, or on none of them
+    int word;
+    for (word = 0; word < words; word++) {
+        uint64_t bits = set[word];
+        while (bits) {
+            int unit = word * 64 + __builtin_ctzll(bits);
+            if (!slot_range_claim(slot_unit(index, resource, unit), first, last)) {
+                //Lost a unit to a concurrent claim: give back the units taken so far
+                int done;
+                for (done = 0; done <= word; done++) {
+                    uint64_t taken = set[done];
+                    if (done == word) taken &= (1ULL << (unit % 64)) - 1;
+                    while (taken) {
+                        slot_range_clear(slot_unit(index, resource, done * 64 + __builtin_ctzll(taken)), first, last);
+                        taken &= taken - 1;
+                    }
+                }
+                return 0;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return 1;
+}
+
+void slot_mask_counts(unsigned int mask, int counts[RESOURCE_NUM]) {
+    //One unit of every resource in mask
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) counts[r] = mask >> r & 1;
+}
+
+int slot_reserve(SlotIndex *index, unsigned int mask, int first, int last, SlotUnits *units) {
+    int counts[RESOURCE_NUM];
+    slot_mask_counts(mask, counts);
+    return slot_reserve_counts(index, counts, first, last, units);
+}
+
+int slot_reserve_counts(SlotIndex *index, const int counts[RESOURCE_NUM], int first, int last, SlotUnits *units) {
+    //Claim counts[r] units of every resource over [first, last], or nothing.
+    //A single unit is claimed by CAS on the unit placement_policy picks, or on
+    //the first unit still free if a concurrent claim took that one; a group
+    //claims any counts[r] units the slot-major rows show free, a block of
+    //adjacent ones when there is one. If some resource cannot be claimed, the
+    //claims already made are released. Two concurrent requests can never both
+    //take the last free unit, though a request may be turned away by a claim
+    //that is rolled back just after. units may be NULL if the caller never
+    //releases the claims; otherwise slot_units_free drops the group sets.
+    SlotUnits held;
+    int r;
+    slot_units_init(&held);
+    if (units) slot_units_init(units);
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (counts[r] <= 0) continue;
+        int unit = -1;
+        if (counts[r] == 1) {
+            unit = slot_place_unit(index->bits[r], index->capacity[r], first, last, placement_policy);
+            if (unit >= 0 && !slot_range_claim(slot_unit(index, r, unit), first, last)) {
+                for (unit = 0; unit < index->capacity[r]; unit++) {
+                    SlotWord *words = slot_unit(index, r, unit);
+                    if (slot_range_free(words, first, last) && slot_range_claim(words, first, last)) break;
+                }
+                if (unit == index->capacity[r]) unit = -1;
+            }
+            if (unit >= 0) slot_columns_mark(index->columns[r], index->capacity[r], unit, 1, first, last, 1);
+        } else if (counts[r] <= index->capacity[r]) {
+            int row = slot_column_words(index->capacity[r]);
+            SlotUnitSet *set = (SlotUnitSet*)malloc(sizeof(SlotUnitSet) + row * sizeof(uint64_t));
+            if (set) {
+                set->words = row;
+                unit = slot_columns_choose(index->columns[r], index->capacity[r], first, last, counts[r], set->bits);
+                if (unit >= 0 && !slot_claim_set(index, r, set->bits, row, first, last)) unit = -1;
+                if (unit >= 0) {
+                    slot_columns_mark_set(index->columns[r], index->capacity[r], set->bits, row, first, last, 1);
+                    held.group[r] = set;
+                } else {
+                    free(set);
+                }
+            }
+        }
+        if (unit < 0) {
+            slot_release_units(index, &held, first, last);
+            slot_units_free(&held);
+            return 0;
+        }
+        held.unit[r] = unit;
+    }
+    if (units) *units = held;
+    else slot_units_free(&held);
+    return 1;
+}
+
+int admit_booking(SlotIndex *index, const Booking *booking, SlotUnits *units) {
+    //FCFS admission of one booking against the live index. Probes every requested
+    //resource first and only claims when all of them are free, like FCFS in run_schedule.
+    int start_day, end_day, start_slot, end_slot;
+    if (units) slot_units_init(units);
+    if (!booking_slot_range(booking, &start_day, &end_day, &start_slot, &end_slot)) return ADMIT_OUT_OF_RANGE;
+    int first = start_day * TIME_SLOT_PER_DAY + start_slot;
+    int last = end_day * TIME_SLOT_PER_DAY + end_slot;
+
+    int counts[RESOURCE_NUM];
+    resource_counts(booking, counts);
+    return slot_reserve_counts(index, counts, first, last, units) ? ADMIT_ACCEPTED : ADMIT_REJECTED;
+}
+
+void release_booking(SlotIndex *index, const Booking *booking, const SlotUnits *units) {
+    //Give back exactly the units admit_booking claimed for this booking
+    int start_day, end_day, start_slot, end_slot;
+    if (!booking_slot_range(booking, &start_day, &end_day, &start_slot, &end_slot)) return;
+    slot_release_units(index, units, start_day * TIME_SLOT_PER_DAY + start_slot, end_day * TIME_SLOT_PER_DAY + end_slot);
+}
+
+void retake_booking(SlotIndex *index, const Booking *booking, const SlotUnits *units) {
+    //Undo release_booking; the units must not have been claimed in between
+    int start_day, end_day, start_slot, end_slot;
+    if (!booking_slot_range(booking, &start_day, &end_day, &start_slot, &end_slot)) return;
+    slot_units_mark(index, units, start_day * TIME_SLOT_PER_DAY + start_slot, end_day * TIME_SLOT_PER_DAY + end_slot, 1);
+}
+
+typedef struct {
+    SlotIndex *index;
+    int iterations;
+    unsigned int seed;
+    int accepted;
+    int *claims;    //resource, unit, first, last of every accepted reservation
+} SlotStressWorker;
+
+void* slot_stress_thread(void *arg) {
+    //Reserve random bundles as fast as possible and remember every claim
+    SlotStressWorker *worker = (SlotStressWorker*)arg;
+    SlotUnits units;
+    int i, r;
+    for (i = 0; i < worker->iterations; i++) {
+        unsigned int mask = 1 | (rand_r(&worker->seed) % (1 << resource_count));
+        int first = rand_r(&worker->seed) % (SLOT_HORIZON - 1);
+        int last = first + rand_r(&worker->seed) % 6;
+        if (last >= SLOT_HORIZON) last = SLOT_HORIZON - 1;
+        if (!slot_reserve(worker->index, mask, first, last, &units)) continue;
+        for (r = 0; r < RESOURCE_NUM; r++) {
+            if (units.unit[r] < 0) continue;
+            int *claim = worker->claims + 4 * (worker->accepted++);
+            claim[0] = r;
+            claim[1] = units.unit[r];
+            claim[2] = first;
+            claim[3] = last;
+        }
+    }
+    return NULL;
+}
+
+int slot_stress_test(int thread_num, int iterations) {
+    //Run thread_num threads against one small index, then check that no unit
+    //slot was handed out twice and that the index holds exactly the claims made
+    int capacity[RESOURCE_NUM];
+    catalog_capacities(capacity);
+    SlotIndex index;
+    if (!slot_index_init(&index, capacity)) return 0;
+
+    pthread_t *threads = (pthread_t*)malloc(thread_num * sizeof(pthread_t));
+    SlotStressWorker *workers = (SlotStressWorker*)calloc(thread_num, sizeof(SlotStressWorker));
+    int t, ok = threads && workers;
+    for (t = 0; ok && t < thread_num; t++) {
+        workers[t].index = &index;
+        workers[t].iterations = iterations;
+        workers[t].seed = 2432u + t;
+        workers[t].claims = (int*)malloc((size_t)iterations * RESOURCE_NUM * 4 * sizeof(int));
+        if (!workers[t].claims) ok = 0;
+    }
+    for (t = 0; ok && t < thread_num; t++) pthread_create(&threads[t], NULL, slot_stress_thread, &workers[t]);
+    for (t = 0; ok && t < thread_num; t++) pthread_join(threads[t], NULL);
+
+    SlotIndex expected;
+    memset(&expected, 0, sizeof(SlotIndex));
+    if (ok && !slot_index_init(&expected, capacity)) ok = 0;
+    int total = 0, r;
+    for (t = 0; ok && t < thread_num; t++) {
+        int c;
+        for (c = 0; c < workers[t].accepted && ok; c++) {
+            int *claim = workers[t].claims + 4 * c;
+            SlotWord *unit = slot_unit(&expected, claim[0], claim[1]);
+            if (!slot_range_free(unit, claim[2], claim[3])) {
+                printf("-> Unit %d of resource %d was claimed twice.\n", claim[1], claim[0]);
+                ok = 0;
+            }
+            slot_range_set(unit, claim[2], claim[3]);
+            total++;
+        }
+    }
+    for (r = 0; ok && r < RESOURCE_NUM; r++) {
+        if (memcmp(expected.bits[r], index.bits[r], (size_t)capacity[r] * SLOT_WORDS_PER_UNIT * sizeof(SlotWord)) != 0) {
+            printf("-> Slot state of resource %d does not match the claims made.\n", r);
+            ok = 0;
+        }
+    }
+    if (ok) printf("-> %d thread(s), %d reservation(s), %d unit claim(s), no conflicts.\n", thread_num, thread_num * iterations, total);
+
+    if (workers) {
+        for (t = 0; t < thread_num; t++) free(workers[t].claims);
+    }
+    free(workers);
+    free(threads);
+    slot_index_free(&expected);
+    slot_index_free(&index);
+    return ok;
+}
+
+typedef struct {
+    SlotIndex *index;
+    int iterations;
+    unsigned int seed;
+    int claimed;
+} SlotBenchmarkWorker;
+
+void* slot_benchmark_thread(void *arg) {
+    //Claim and release random single-resource ranges
+    SlotBenchmarkWorker *worker = (SlotBenchmarkWorker*)arg;
+    SlotUnits units;
+    int i;
+    for (i = 0; i < worker->iterations; i++) {
+        unsigned int mask = 1u << (rand_r(&worker->seed) % resource_count);
+        int first = rand_r(&worker->seed) % (SLOT_HORIZON - 1);
+        int last = first + rand_r(&worker->seed) % 4;
+        if (last >= SLOT_HORIZON) last = SLOT_HORIZON - 1;
+        if (slot_reserve(worker->index, mask, first, last, &units)) {
+            worker->claimed++;
+            slot_release_units(worker->index, &units, first, last);
+        }
+    }
+    return NULL;
+}
+
+void slot_benchmark(int max_threads) {
+    //Print claims per second for 1, 2, 4, ... max_threads threads
+    int capacity[RESOURCE_NUM];
+    catalog_capacities(capacity);
+    int iterations = 200000;
+    int thread_num;
+    printf("%-10s%-16s%-16s\n", "Threads", "Claims/s", "Speedup");
+    double base = 0;
+    for (thread_num = 1; thread_num <= max_threads; thread_num *= 2) {
+        SlotIndex index;
+        if (!slot_index_init(&index, capacity)) return;
+        pthread_t threads[thread_num];
+        SlotBenchmarkWorker workers[thread_num];
+        struct timespec start, end;
+        int t, claimed = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (t = 0; t < thread_num; t++) {
+            workers[t].index = &index;
+            workers[t].iterations = iterations;
+            workers[t].seed = 2432u + t;
+            workers[t].claimed = 0;
+            pthread_create(&threads[t], NULL, slot_benchmark_thread, &workers[t]);
+        }
+        for (t = 0; t < thread_num; t++) {
+            pthread_join(threads[t], NULL);
+            claimed += workers[t].claimed;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double rate = claimed / seconds;
+        if (thread_num == 1) base = rate;
+        printf("%-10d%-16.0f%-16.2f\n", thread_num, rate, rate / base);
+        slot_index_free(&index);
+    }
+}
+
+void placement_benchmark(int requests, int rounds) {
+    //Admit the same generated workloads under every placement policy and
+    //compare the share of requests accepted, the share of long (8 h and more)
+    //requests accepted and the time per request. A workload offers about a
+    //quarter more parking hours than the testing period holds.
+    int capacity[RESOURCE_NUM];
+    catalog_capacities(capacity);
+    int *workload = (int*)malloc((size_t)requests * 3 * sizeof(int));  //mask, first, last of every request
+    if (!workload) return;
+    int saved_policy = placement_policy;
+    int policy, round, i;
+    //The first essential and its bundle, battery and cable in the built-in catalog
+    unsigned int essentials = resource_count > 1 ? (1u << 1) | resource_catalog[1].bundle : 0;
+    printf("%-12s%-12s%-16s%-12s\n", "Policy", "Accepted", "Long accepted", "ns/request");
+    for (policy = 0; policy < PLACEMENT_NUM; policy++) {
+        long accepted = 0, long_requests = 0, long_accepted = 0;
+        double ns = 0;
+        for (round = 0; round < rounds; round++) {
+            //Every policy sees the same workloads
+            unsigned int seed = 2432u + round;
+            for (i = 0; i < requests; i++) {
+                int hours = rand_r(&seed) % 5 == 0 ? 8 + rand_r(&seed) % 17 : 1 + rand_r(&seed) % 4;
+                int slots = hours * 60 / SLOT_MINUTES;
+                //A space, a third of them with the essentials above
+                workload[3 * i] = 1 | (rand_r(&seed) % 3 == 0 ? essentials : 0);
+                workload[3 * i + 1] = rand_r(&seed) % (SLOT_HORIZON - slots);
+                workload[3 * i + 2] = workload[3 * i + 1] + slots - 1;
+            }
+
+            SlotIndex index;
+            if (!slot_index_init(&index, capacity)) break;
+            placement_policy = policy;
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (i = 0; i < requests; i++) {
+                int ok = slot_reserve(&index, workload[3 * i], workload[3 * i + 1], workload[3 * i + 2], NULL);
+                int is_long = workload[3 * i + 2] - workload[3 * i + 1] + 1 >= 8 * 60 / SLOT_MINUTES;
+                accepted += ok;
+                long_requests += is_long;
+                long_accepted += ok && is_long;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            ns += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+            slot_index_free(&index);
+        }
+        double total = (double)requests * rounds;
+        printf("%-12s%-12.1f%-16.1f%-12.0f\n", PLACEMENT_NAMES[policy], 100.0 * accepted / total,
+               long_requests ? 100.0 * long_accepted / long_requests : 0, ns / total);
+    }
+    placement_policy = saved_policy;
+    free(workload);
+}
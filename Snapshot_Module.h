@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "node.h"
+
+#define SNAPSHOT_FILE "bookings.snap"
+#define SNAPSHOT_MAGIC "PBSN"
+#define SNAPSHOT_VERSION 8
+
+//File layout: header, the name of every member id and site id of the writer,
+//booking_count Booking records of every site, then the slot occupancy of the
+//last scheduling run when has_occupancy is set. Ids are only meaningful with
+//the registries of the writer, so the loader maps them back through the names.
+typedef struct {
+    char magic[4];
+    int version;
+    int booking_size;       //sizeof(Booking) of the writer, guards against layout changes
+    int booking_count;
+    int member_count;       //Names of MEMBER_NAME_LEN bytes, indexed by member id
+    int site_count;         //Names of SITE_NAME_LEN bytes, indexed by site id
+    int has_occupancy;
+    int slot_minutes;       //SLOT_MINUTES of the writer, the occupancy layout depends on it
+} SnapshotHeader;
+
+int save_snapshot(const char *filename, Node **lists, int list_count, int include_occupancy);
+int load_snapshot(const char *filename, Node **head, Node **tail);
+
+int save_snapshot(const char *filename, Node **lists, int list_count, int include_occupancy) {
+    //Serialize the booking stores into one buffer and write it with a single write
+    int count = 0, list;
+    Node *current;
+    for (list = 0; list < list_count; list++) {
+        for (current = lists[list]; current != NULL; current = current->next) count++;
+    }
+
+    size_t occupancy_size = include_occupancy ? sizeof(slot_occupancy) : 0;
+    size_t names_size = (size_t)member_count * MEMBER_NAME_LEN + (size_t)list_count * SITE_NAME_LEN;
+    size_t size = sizeof(SnapshotHeader) + names_size + (size_t)count * sizeof(Booking) + occupancy_size;
+    char *buffer = (char*)calloc(size, 1);
+    if (!buffer) return -1;
+
+    SnapshotHeader *header = (SnapshotHeader*)buffer;
+    memset(header, 0, sizeof(SnapshotHeader));
+    memcpy(header->magic, SNAPSHOT_MAGIC, 4);
+    header->version = SNAPSHOT_VERSION;
+    header->booking_size = sizeof(Booking);
+    header->booking_count = count;
+    header->member_count = member_count;
+    header->site_count = list_count;
+    header->has_occupancy = include_occupancy;
+    header->slot_minutes = SLOT_MINUTES;
+
+    char *names = buffer + sizeof(SnapshotHeader);
+    int i;
+    //The registries keep names shorter than their field, the rest stays zero
+    for (i = 0; i < member_count; i++) memcpy(names + (size_t)i * MEMBER_NAME_LEN, member_name(i), strlen(member_name(i)));
+    names += (size_t)member_count * MEMBER_NAME_LEN;
+    for (i = 0; i < list_count; i++) memcpy(names + (size_t)i * SITE_NAME_LEN, site_name(i), strlen(site_name(i)));
+
+    Booking *records = (Booking*)(buffer + sizeof(SnapshotHeader) + names_size);
+    i = 0;
+    for (list = 0; list < list_count; list++) {
+        for (current = lists[list]; current != NULL; current = current->next) records[i++] = current->booking;
+    }
+    if (include_occupancy) memcpy(records + count, slot_occupancy, occupancy_size);
+
+    //Write to a temporary file and rename, so a crash never leaves a torn snapshot
+    char temp_name[256];
+    snprintf(temp_name, sizeof(temp_name), "%s.tmp", filename);
+    int fd = open(temp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        free(buffer);
+        return -1;
+    }
+    ssize_t written = write(fd, buffer, size);
+    int ok = (written == (ssize_t)size) && fsync(fd) == 0;
+    close(fd);
+    free(buffer);
+    if (!ok || rename(temp_name, filename) == -1) {
+        unlink(temp_name);
+        return -1;
+    }
+    return count;
+}
+
+int load_snapshot(const char *filename, Node **head, Node **tail) {
+    //Map the snapshot and rebuild the booking list in one allocation
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const SnapshotHeader *header = (const SnapshotHeader*)map;
+    size_t count = header->booking_count;
+    size_t occupancy_size = header->has_occupancy ? sizeof(slot_occupancy) : 0;
+    size_t names_size = (size_t)header->member_count * MEMBER_NAME_LEN + (size_t)header->site_count * SITE_NAME_LEN;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, 4) != 0 ||
+        header->version != SNAPSHOT_VERSION ||
+        header->booking_size != sizeof(Booking) ||
+        header->slot_minutes != SLOT_MINUTES ||
+        header->booking_count < 0 || header->member_count < 0 || header->site_count < 0 ||
+        (size_t)st.st_size != sizeof(SnapshotHeader) + names_size + count * sizeof(Booking) + occupancy_size) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    //Ids of the writer to ids of the registries now, registering names that are new
+    int *member_ids = (int*)malloc((header->member_count + 1) * sizeof(int));
+    int *site_ids = (int*)malloc((header->site_count + 1) * sizeof(int));
+    Node *nodes = count > 0 ? (Node*)malloc(count * sizeof(Node)) : NULL;
+    int ok = member_ids && site_ids && (count == 0 || nodes);
+    const char *names = (const char*)map + sizeof(SnapshotHeader);
+    char name[MEMBER_NAME_LEN > SITE_NAME_LEN ? MEMBER_NAME_LEN : SITE_NAME_LEN];
+    int id;
+    for (id = 0; ok && id < header->member_count; id++) {
+        snprintf(name, sizeof(name), "%.*s", MEMBER_NAME_LEN - 1, names + (size_t)id * MEMBER_NAME_LEN);
+        member_ids[id] = member_register(name);
+        if (member_ids[id] < 0) ok = 0;
+    }
+    names += (size_t)header->member_count * MEMBER_NAME_LEN;
+    for (id = 0; ok && id < header->site_count; id++) {
+        snprintf(name, sizeof(name), "%.*s", SITE_NAME_LEN - 1, names + (size_t)id * SITE_NAME_LEN);
+        site_ids[id] = site_resolve(name);
+        if (site_ids[id] < 0) ok = 0;
+    }
+
+    const Booking *records = (const Booking*)((const char*)map + sizeof(SnapshotHeader) + names_size);
+    size_t i;
+    for (i = 0; ok && i < count; i++) {
+        nodes[i].booking = records[i];
+        nodes[i].next = (i + 1 < count) ? &nodes[i + 1] : NULL;
+        int member = records[i].member_id, site = records[i].site_id;
+        if (member >= header->member_count || site < 0 || site >= header->site_count) ok = 0;
+        else {
+            nodes[i].booking.member_id = member < 0 ? -1 : member_ids[member];
+            nodes[i].booking.site_id = site_ids[site];
+        }
+    }
+    free(member_ids);
+    free(site_ids);
+    if (!ok) {
+        free(nodes);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    if (header->has_occupancy) {
+        memcpy(slot_occupancy, records + count, occupancy_size);
+        slot_occupancy_valid = 1;
+    }
+    munmap(map, st.st_size);
+
+    *head = count > 0 ? &nodes[0] : NULL;
+    *tail = count > 0 ? &nodes[count - 1] : NULL;
+    return (int)count;
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "node.h"
+
+//Validation error codes, one bit each so a line can report every bad field.
+//Callers report the lowest bit set, which is the first check that failed.
+#define INVALID_UNKNOWN_COMMAND 0x01
+#define INVALID_FIELD_COUNT     0x02
+#define INVALID_MEMBER          0x04
+#define INVALID_DATE            0x08
+#define INVALID_TIME            0x10
+#define INVALID_DURATION        0x20
+#define INVALID_QUANTITY        0x40
+#define INVALID_ESSENTIALS      0x80
+
+#define VALIDATE_RECORD 16  //Staged record: YYYY-MM-DD hh:mm plus one filler digit
+
+int validate_date(const char *date);
+int validate_time(const char *time);
+int validate_duration(const char *hours);
+int validate_calendar(const unsigned char *record);
+int validate_fields(const char *date, const char *time, const char *hours);
+void validate_fields_batch(char *const *dates, char *const *times, char *const *hours, int n, unsigned char *errors);
+int first_validation_error(int errors);
+
+int validate_date(const char *date) {
+    //YYYY-MM-DD with digits everywhere else and a real calendar day
+    unsigned char record[VALIDATE_RECORD];
+    if (strnlen(date, 11) != 10) return INVALID_DATE;
+    memcpy(record, date, 10);
+    memcpy(record + 10, "00:000", 6);
+    int i;
+    for (i = 0; i < 10; i++) {
+        if (i == 4 || i == 7) {
+            if (record[i] != '-') return INVALID_DATE;
+        } else if (record[i] < '0' || record[i] > '9') {
+            return INVALID_DATE;
+        }
+    }
+    return validate_calendar(record);
+}
+
+int validate_time(const char *time) {
+    //hh:mm within one day
+    unsigned char record[VALIDATE_RECORD];
+    if (strnlen(time, 6) != 5) return INVALID_TIME;
+    memcpy(record, "2025-01-01", 10);
+    memcpy(record + 10, time, 5);
+    record[15] = '0';
+    int i;
+    for (i = 10; i < 15; i++) {
+        if (i == 12) {
+            if (record[i] != ':') return INVALID_TIME;
+        } else if (record[i] < '0' || record[i] > '9') {
+            return INVALID_TIME;
+        }
+    }
+    return validate_calendar(record);
+}
+
+int validate_duration(const char *hours) {
+    //n or n.n (a trailing ';' of the last field is ignored), covering a whole
+    //number of time slots; parsed as an exact decimal instead of with atof
+    long minutes = 0, scale = 60, fraction = 0;
+    int digits = 0, dot = 0;
+    const char *p;
+    for (p = hours; *p != '\0' && !(*p == ';' && p[1] == '\0'); p++) {
+        if (*p == '.' && !dot) {
+            dot = 1;
+        } else if (*p >= '0' && *p <= '9') {
+            if (++digits > 6) return INVALID_DURATION;
+            if (dot) {
+                scale *= 10;
+                fraction = fraction * 10 + (*p - '0');
+            } else {
+                minutes = minutes * 10 + (*p - '0') * 60;
+            }
+        } else {
+            return INVALID_DURATION;
+        }
+    }
+    if (digits == 0) return INVALID_DURATION;
+    //fraction / (scale / 60) hours must be a whole number of minutes
+    if ((fraction * 60 * 60) % scale != 0) return INVALID_DURATION;
+    minutes += fraction * 60 * 60 / scale;
+    return minutes % SLOT_MINUTES == 0 ? 0 : INVALID_DURATION;
+}
+
+int validate_calendar(const unsigned char *record) {
+    //Range checks of a staged record whose digits are already verified
+    static const int days_in_month[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int errors = 0;
+    int year = (record[0] - '0') * 1000 + (record[1] - '0') * 100 + (record[2] - '0') * 10 + (record[3] - '0');
+    int month = (record[5] - '0') * 10 + (record[6] - '0');
+    int day = (record[8] - '0') * 10 + (record[9] - '0');
+    int hour = (record[10] - '0') * 10 + (record[11] - '0');
+    int minute = (record[13] - '0') * 10 + (record[14] - '0');
+    if (month < 1 || month > 12) {
+        errors |= INVALID_DATE;
+    } else {
+        int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        int last_day = days_in_month[month - 1] + (month == 2 && leap);
+        if (day < 1 || day > last_day) errors |= INVALID_DATE;
+    }
+    if (hour > 23 || minute > 59) errors |= INVALID_TIME;
+    return errors;
+}
+
+int validate_fields(const char *date, const char *time, const char *hours) {
+    return validate_date(date) | validate_time(time) | validate_duration(hours);
+}
+
+void validate_fields_batch(char *const *dates, char *const *times, char *const *hours, int n, unsigned char *errors) {
+    //Stage date and time of every line into one fixed 16-byte record, check
+    //digit and separator positions of a whole record with one vector compare,
+    //then run the calendar ranges. A NULL date marks a line without fields.
+    unsigned char *records = (unsigned char*)malloc((size_t)n * VALIDATE_RECORD + 1);
+    if (!records) {
+        int i;
+        for (i = 0; i < n; i++) errors[i] = dates[i] ? validate_fields(dates[i], times[i], hours[i]) : 0;
+        return;
+    }
+
+    int i;
+    for (i = 0; i < n; i++) {
+        unsigned char *record = records + (size_t)i * VALIDATE_RECORD;
+        errors[i] = 0;
+        memcpy(record, "2025-01-01", 10);
+        memcpy(record + 10, "00:000", 6);
+        if (!dates[i]) continue;
+        if (strnlen(dates[i], 11) == 10) memcpy(record, dates[i], 10);
+        else errors[i] |= INVALID_DATE;
+        if (strnlen(times[i], 6) == 5) memcpy(record + 10, times[i], 5);
+        else errors[i] |= INVALID_TIME;
+        errors[i] |= validate_duration(hours[i]);
+    }
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i separators = _mm_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-', 0, 0, 0, 0, ':', 0, 0, 0);
+    const int separator_bits = (1 << 4) | (1 << 7) | (1 << 12);
+    for (i = 0; i < n; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(records + (size_t)i * VALIDATE_RECORD));
+        __m128i d = _mm_sub_epi8(v, zero);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_max_epu8(d, nine), nine);
+        __m128i is_separator = _mm_cmpeq_epi8(v, separators);
+        int bad = ~((_mm_movemask_epi8(is_digit) & ~separator_bits) | (_mm_movemask_epi8(is_separator) & separator_bits)) & 0xFFFF;
+        if (bad & 0x03FF) errors[i] |= INVALID_DATE;
+        if (bad & 0x7C00) errors[i] |= INVALID_TIME;
+        if (!bad) errors[i] |= validate_calendar(records + (size_t)i * VALIDATE_RECORD);
+    }
+#else
+    for (i = 0; i < n; i++) {
+        const unsigned char *record = records + (size_t)i * VALIDATE_RECORD;
+        int j, bad = 0;
+        for (j = 0; j < VALIDATE_RECORD; j++) {
+            int separator = (j == 4 || j == 7) ? '-' : (j == 12 ? ':' : 0);
+            int ok = separator ? record[j] == separator : (record[j] >= '0' && record[j] <= '9');
+            if (!ok) bad |= 1 << j;
+        }
+        if (bad & 0x03FF) errors[i] |= INVALID_DATE;
+        if (bad & 0x7C00) errors[i] |= INVALID_TIME;
+        if (!bad) errors[i] |= validate_calendar(record);
+    }
+#endif
+    free(records);
+}
+
+int first_validation_error(int errors) {
+    //Lowest error bit, the one the interactive checks would have reported
+    return errors & -errors;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "node.h"
+
+//Bookings turned away by online admission wait here until capacity frees up.
+//A waiting booking is filed under every (resource, day) bucket its range
+//touches, so freeing a range only looks at the bookings that could use it.
+//Removal just clears the booking's flag; buckets drop stale ids when scanned.
+IdList waitlist_buckets[RESOURCE_NUM][TESTING_DAY];
+unsigned char *waitlist_flags = NULL;   //Indexed by booking id, 1 while waiting
+int waitlist_flag_allocated = 0;
+int waitlist_count = 0;
+
+void waitlist_clear();
+int waitlist_add(const Booking *booking);
+void waitlist_remove(int booking_id);
+int waitlist_waiting(int booking_id);
+int waitlist_candidates(unsigned int mask, int first_day, int last_day, int **ids);
+int compare_booking_id(const void *a, const void *b);
+
+void waitlist_clear() {
+    int r, day;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        for (day = 0; day < TESTING_DAY; day++) waitlist_buckets[r][day].count = 0;
+    }
+    if (waitlist_flags) memset(waitlist_flags, 0, waitlist_flag_allocated);
+    waitlist_count = 0;
+}
+
+int waitlist_add(const Booking *booking) {
+    //File a rejected booking under its resources and days, return 0 on failure
+    int start_day, end_day, start_slot, end_slot;
+    int id = booking->booking_id;
+    if (id <= 0 || !booking_slot_range(booking, &start_day, &end_day, &start_slot, &end_slot)) return 0;
+    if (waitlist_waiting(id)) return 1;
+    if (id >= waitlist_flag_allocated) {
+        int allocated = waitlist_flag_allocated ? waitlist_flag_allocated : 1024;
+        while (allocated <= id) allocated *= 2;
+        unsigned char *grown = (unsigned char*)realloc(waitlist_flags, allocated);
+        if (!grown) return 0;
+        memset(grown + waitlist_flag_allocated, 0, allocated - waitlist_flag_allocated);
+        waitlist_flags = grown;
+        waitlist_flag_allocated = allocated;
+    }
+
+    //The inclusive end slot may be slot 0 of the next day
+    int first_day = start_day;
+    int last_day = (end_day * TIME_SLOT_PER_DAY + end_slot) / TIME_SLOT_PER_DAY;
+    if (last_day >= TESTING_DAY) last_day = TESTING_DAY - 1;
+    unsigned int mask = resource_mask(booking);
+    int r, day;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (!(mask >> r & 1)) continue;
+        for (day = first_day; day <= last_day; day++) {
+            if (!id_list_push(&waitlist_buckets[r][day], id)) return 0;
+        }
+    }
+    waitlist_flags[id] = 1;
+    waitlist_count++;
+    return 1;
+}
+
+void waitlist_remove(int booking_id) {
+    if (!waitlist_waiting(booking_id)) return;
+    waitlist_flags[booking_id] = 0;
+    waitlist_count--;
+}
+
+int waitlist_waiting(int booking_id) {
+    return booking_id > 0 && booking_id < waitlist_flag_allocated && waitlist_flags[booking_id];
+}
+
+int waitlist_candidates(unsigned int mask, int first_day, int last_day, int **ids) {
+    //Waiting bookings filed under a resource of mask on a day of [first_day,
+    //last_day], earliest id first and each once. *ids is malloc'd; return the count or -1.
+    int total = 0, r, day;
+    if (first_day < 0) first_day = 0;
+    if (last_day >= TESTING_DAY) last_day = TESTING_DAY - 1;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (!(mask >> r & 1)) continue;
+        for (day = first_day; day <= last_day; day++) {
+            //Compact the bucket while counting
+            IdList *bucket = &waitlist_buckets[r][day];
+            int i, kept = 0;
+            for (i = 0; i < bucket->count; i++) {
+                if (waitlist_waiting(bucket->ids[i])) bucket->ids[kept++] = bucket->ids[i];
+            }
+            bucket->count = kept;
+            total += kept;
+        }
+    }
+
+    *ids = (int*)malloc((total + 1) * sizeof(int));
+    if (!*ids) return -1;
+    int n = 0;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (!(mask >> r & 1)) continue;
+        for (day = first_day; day <= last_day; day++) {
+            memcpy(*ids + n, waitlist_buckets[r][day].ids, waitlist_buckets[r][day].count * sizeof(int));
+            n += waitlist_buckets[r][day].count;
+        }
+    }
+    qsort(*ids, n, sizeof(int), compare_booking_id);
+    int i, unique = 0;
+    for (i = 0; i < n; i++) {
+        if (unique == 0 || (*ids)[unique - 1] != (*ids)[i]) (*ids)[unique++] = (*ids)[i];
+    }
+    return unique;
+}
+
+int compare_booking_id(const void *a, const void *b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
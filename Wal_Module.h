@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "node.h"
+
+#define WAL_FILE "bookings.wal"
+#define WAL_RECORD_MAGIC 0x4C415750u   //"PWAL"
+#define WAL_CANCEL_MAGIC 0x43415750u   //"PWAC"
+#define WAL_MODIFY_MAGIC 0x4D415750u   //"PWAM"
+#define WAL_GROUP_SIZE 4096             //Records buffered before a forced group commit
+
+//Record kinds, passed to the replay callback
+#define WAL_APPEND 0    //A new booking
+#define WAL_CANCEL 1    //Booking booking_id was cancelled
+#define WAL_MODIFY 2    //Booking booking_id now reads as the logged one
+
+//Each validated booking is appended as one fixed-size record, and so is each
+//later change to it; the magic tells the kinds apart. A record whose magic or
+//checksum does not match marks a torn tail left by a crash. Member and site
+//ids only hold in the registries of the writer, so their names are logged too
+//and replay maps them to the ids of the registries now.
+typedef struct {
+    unsigned int magic;
+    unsigned int checksum;      //Of everything after it
+    char member[MEMBER_NAME_LEN];
+    char site[SITE_NAME_LEN];
+    Booking booking;
+} WalRecord;
+
+int wal_fd = -1;
+WalRecord wal_buffer[WAL_GROUP_SIZE];
+int wal_pending = 0;
+
+unsigned int wal_checksum(const WalRecord *record);
+int wal_open(const char *filename);
+unsigned int wal_kind_magic(int kind);
+void wal_append(const Booking *booking);
+void wal_log(int kind, const Booking *booking);
+int wal_commit();
+int wal_truncate();
+int wal_replay(const char *filename, void (*apply)(int kind, Booking *booking));
+int wal_resolve(WalRecord *record);
+
+unsigned int wal_checksum(const WalRecord *record) {
+    //FNV-1a over the record bytes after the checksum
+    const unsigned char *p = (const unsigned char*)record->member;
+    size_t size = sizeof(WalRecord) - offsetof(WalRecord, member);
+    unsigned int hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int wal_open(const char *filename) {
+    //Open the log for appending, return 0 on failure
+    wal_fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (wal_fd == -1) {
+        perror("open");
+        return 0;
+    }
+    return 1;
+}
+
+unsigned int wal_kind_magic(int kind) {
+    switch (kind) {
+        case WAL_CANCEL: return WAL_CANCEL_MAGIC;
+        case WAL_MODIFY: return WAL_MODIFY_MAGIC;
+        default: return WAL_RECORD_MAGIC;
+    }
+}
+
+void wal_append(const Booking *booking) {
+    wal_log(WAL_APPEND, booking);
+}
+
+void wal_log(int kind, const Booking *booking) {
+    //Buffer the record; it becomes durable at the next group commit
+    if (wal_fd == -1) return;
+    WalRecord *record = &wal_buffer[wal_pending++];
+    memset(record, 0, sizeof(WalRecord));
+    record->magic = wal_kind_magic(kind);
+    if (booking->member_id >= 0) memcpy(record->member, member_name(booking->member_id), strlen(member_name(booking->member_id)));
+    memcpy(record->site, site_name(booking->site_id), strlen(site_name(booking->site_id)));
+    record->booking = *booking;
+    record->checksum = wal_checksum(record);
+    if (wal_pending == WAL_GROUP_SIZE) wal_commit();
+}
+
+int wal_commit() {
+    //Write all pending records with one write and one fdatasync
+    if (wal_fd == -1 || wal_pending == 0) return 1;
+    size_t size = wal_pending * sizeof(WalRecord);
+    const char *p = (const char*)wal_buffer;
+    while (size > 0) {
+        ssize_t n = write(wal_fd, p, size);
+        if (n <= 0) {
+            perror("write");
+            return 0;
+        }
+        p += n;
+        size -= n;
+    }
+    wal_pending = 0;
+    if (fdatasync(wal_fd) == -1) {
+        perror("fdatasync");
+        return 0;
+    }
+    return 1;
+}
+
+int wal_truncate() {
+    //Drop the log once its records are covered by a snapshot
+    if (wal_fd == -1) return 0;
+    wal_pending = 0;
+    return ftruncate(wal_fd, 0) == 0 && fdatasync(wal_fd) == 0;
+}
+
+int wal_replay(const char *filename, void (*apply)(int kind, Booking *booking)) {
+    //Apply every intact record in order and cut off a torn tail, return records applied or -1
+    int fd = open(filename, O_RDWR);
+    if (fd == -1) return -1;
+
+    WalRecord *records = (WalRecord*)malloc(WAL_GROUP_SIZE * sizeof(WalRecord));
+    if (!records) {
+        close(fd);
+        return -1;
+    }
+
+    int applied = 0, torn = 0;
+    off_t valid_size = 0;
+    while (!torn) {
+        ssize_t n = read(fd, records, WAL_GROUP_SIZE * sizeof(WalRecord));
+        if (n <= 0) break;
+        int count = n / sizeof(WalRecord);
+        if (n % sizeof(WalRecord) != 0) torn = 1;
+        int i;
+        for (i = 0; i < count; i++) {
+            int kind = -1, k;
+            for (k = WAL_APPEND; k <= WAL_MODIFY; k++) {
+                if (records[i].magic == wal_kind_magic(k)) kind = k;
+            }
+            if (kind < 0 || records[i].checksum != wal_checksum(&records[i])) {
+                torn = 1;
+                break;
+            }
+            valid_size += sizeof(WalRecord);
+            if (!wal_resolve(&records[i])) {
+                printf("-> Log record of booking %d skipped: member %s or site %s cannot be registered.\n",
+                       records[i].booking.booking_id, records[i].member, records[i].site);
+                continue;
+            }
+            apply(kind, &records[i].booking);
+            applied++;
+        }
+    }
+    if (torn) {
+        printf("-> Discarding incomplete log tail of %s.\n", filename);
+        if (ftruncate(fd, valid_size) == -1) perror("ftruncate");
+    }
+    free(records);
+    close(fd);
+    return applied;
+}
+
+int wal_resolve(WalRecord *record) {
+    //Give the logged booking the ids its member and site names have now,
+    //registering names that are new. Return 0 if one cannot be registered.
+    record->member[MEMBER_NAME_LEN - 1] = '\0';
+    record->site[SITE_NAME_LEN - 1] = '\0';
+    record->booking.member_id = record->member[0] ? member_register(record->member) : -1;
+    record->booking.site_id = site_resolve(record->site);
+    return (record->booking.member_id >= 0 || !record->member[0]) && record->booking.site_id >= 0;
+}
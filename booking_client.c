@@ -0,0 +1,184 @@
+//Load-test client for the booking server started with: startServer -/path/to/socket;
+//
+//  gcc -O2 -pthread booking_client.c -o booking_client
+//  ./booking_client <socket> [clients] [requests per client] [pipeline depth] [-shutdown]
+//
+//Every client opens its own connection, sends pipeline-depth commands at a time
+//and waits for all of their replies. Throughput and per-round-trip latency
+//percentiles are printed at the end. -shutdown stops the server afterwards.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define CLIENT_COMMAND_SIZE 128
+
+typedef struct {
+    int id;
+    int requests;
+    int pipeline;
+    int ok;
+    int invalid;
+    int rounds;
+    double *latency_us;
+} ClientStats;
+
+const char *client_socket_path;
+const char *client_commands[] = {"addParking", "addReservation", "bookEssentials", "addEvent"};
+const char *client_members[] = {"member_A", "member_B", "member_C", "member_D", "member_E"};
+const char *client_essentials[] = {"battery", "cable", "locker", "umbrella"};
+
+int connect_server(const char *path);
+int generate_command(char *buffer, unsigned int *seed);
+void* client_thread(void *arg);
+int compare_double(const void *a, const void *b);
+double now_us();
+
+int connect_server(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int generate_command(char *buffer, unsigned int *seed) {
+    //Random request in the same syntax as the interactive prompt
+    int type = rand_r(seed) % 4;
+    int length = snprintf(buffer, CLIENT_COMMAND_SIZE, "%s -%s 2025-05-%02d %02d:00 %d.0 %s",
+                          client_commands[type], client_members[rand_r(seed) % 5],
+                          10 + rand_r(seed) % 7, rand_r(seed) % 24, 1 + rand_r(seed) % 4,
+                          client_essentials[rand_r(seed) % 4]);
+    if (type == 1) length += snprintf(buffer + length, CLIENT_COMMAND_SIZE - length, " %s", client_essentials[rand_r(seed) % 4]);
+    length += snprintf(buffer + length, CLIENT_COMMAND_SIZE - length, ";\n");
+    return length;
+}
+
+double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void* client_thread(void *arg) {
+    ClientStats *stats = (ClientStats*)arg;
+    unsigned int seed = 2432u + stats->id;
+    int fd = connect_server(client_socket_path);
+    if (fd == -1) {
+        perror("connect");
+        return NULL;
+    }
+
+    char *request = (char*)malloc(stats->pipeline * CLIENT_COMMAND_SIZE);
+    char reply[65536];
+    int sent_total = 0;
+    while (sent_total < stats->requests) {
+        int batch = stats->pipeline;
+        if (batch > stats->requests - sent_total) batch = stats->requests - sent_total;
+        int length = 0, i;
+        for (i = 0; i < batch; i++) length += generate_command(request + length, &seed);
+
+        double start = now_us();
+        int sent = 0;
+        while (sent < length) {
+            ssize_t n = write(fd, request + sent, length - sent);
+            if (n <= 0) goto done;
+            sent += n;
+        }
+        //Every command gets exactly one reply line
+        int lines = 0;
+        while (lines < batch) {
+            ssize_t n = read(fd, reply, sizeof(reply));
+            if (n <= 0) goto done;
+            for (i = 0; i < n; i++) {
+                if (reply[i] == '\n') lines++;
+                else if (reply[i] == 'O' && (i == 0 || reply[i - 1] == '\n')) stats->ok++;
+                else if (reply[i] == 'I' && (i == 0 || reply[i - 1] == '\n')) stats->invalid++;
+            }
+        }
+        stats->latency_us[stats->rounds++] = now_us() - start;
+        sent_total += batch;
+    }
+done:
+    free(request);
+    close(fd);
+    return NULL;
+}
+
+int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("usage: %s <socket> [clients] [requests per client] [pipeline depth] [-shutdown]\n", argv[0]);
+        return 1;
+    }
+    client_socket_path = argv[1];
+    int clients = argc > 2 ? atoi(argv[2]) : 8;
+    int requests = argc > 3 ? atoi(argv[3]) : 10000;
+    int pipeline = argc > 4 ? atoi(argv[4]) : 16;
+    int stop = argc > 5 && strcmp(argv[5], "-shutdown") == 0;
+    if (clients < 1) clients = 1;
+    if (pipeline < 1) pipeline = 1;
+
+    pthread_t *threads = (pthread_t*)malloc(clients * sizeof(pthread_t));
+    ClientStats *stats = (ClientStats*)calloc(clients, sizeof(ClientStats));
+    int i;
+    double start = now_us();
+    for (i = 0; i < clients; i++) {
+        stats[i].id = i;
+        stats[i].requests = requests;
+        stats[i].pipeline = pipeline;
+        stats[i].latency_us = (double*)malloc((requests / pipeline + 1) * sizeof(double));
+        pthread_create(&threads[i], NULL, client_thread, &stats[i]);
+    }
+    int ok = 0, invalid = 0, rounds = 0;
+    for (i = 0; i < clients; i++) {
+        pthread_join(threads[i], NULL);
+        ok += stats[i].ok;
+        invalid += stats[i].invalid;
+        rounds += stats[i].rounds;
+    }
+    double elapsed = (now_us() - start) / 1e6;
+
+    double *latency = (double*)malloc((rounds + 1) * sizeof(double));
+    int n = 0, j;
+    for (i = 0; i < clients; i++) {
+        for (j = 0; j < stats[i].rounds; j++) latency[n++] = stats[i].latency_us[j];
+    }
+    qsort(latency, n, sizeof(double), compare_double);
+
+    printf("clients %d, pipeline %d, requests %d (%d ok, %d invalid)\n", clients, pipeline, ok + invalid, ok, invalid);
+    printf("elapsed %.3f s, throughput %.0f requests/s\n", elapsed, (ok + invalid) / elapsed);
+    if (n > 0) {
+        printf("round trip latency p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+               latency[n / 2], latency[(int)(n * 0.99)], latency[(int)(n * 0.999)], latency[n - 1]);
+    }
+
+    if (stop) {
+        int fd = connect_server(client_socket_path);
+        if (fd != -1) {
+            char reply[16];
+            write(fd, "shutdownServer;\n", 16);
+            read(fd, reply, sizeof(reply));
+            close(fd);
+        }
+    }
+
+    for (i = 0; i < clients; i++) free(stats[i].latency_us);
+    free(latency);
+    free(stats);
+    free(threads);
+    return 0;
+}
@@ -1,42 +1,220 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include "node.h"
+#include "Catalog_Module.h"
+#include "Slot_Module.h"
+#include "Ring_Module.h"
 #include "Schedule_Module.h"
+#include "Member_Module.h"
+#include "Index_Module.h"
+#include "Waitlist_Module.h"
+#include "Availability_Module.h"
+#include "Validate_Module.h"
+#include "Site_Module.h"
+#include "Shard_Module.h"
+#include "Aio_Module.h"
 #include "Analyzer_Module.h"
+#include "Snapshot_Module.h"
+#include "Wal_Module.h"
+#include "Server_Module.h"
+
+//Results of executeCommand
+#define COMMAND_INVALID 0
+#define COMMAND_STORED 1        //Stored for the next printBookings run
+#define COMMAND_ACCEPTED 2      //Online admission: slot claimed
+#define COMMAND_REJECTED 3      //Online admission: no slot free
+#define COMMAND_OUT_OF_RANGE 4  //Online admission: not in testing period
+
+#define BATCH_BLOCK_LINES 4096  //Commands tokenized and validated together by addBatch
+#define BATCH_SENTENCE_SIZE 256
+#define BATCH_WINDOW_SIZE (16 << 20)   //Bytes of a batch read and parsed at a time
+#define BATCH_MIN_CHUNK 65536           //Smaller windows are not worth another thread
+#define BATCH_CHUNKS_PER_THREAD 4       //Extra chunks even out uneven lines
+#define BATCH_MAX_THREADS 64
+#define BATCH_NO_MEMORY -1              //runBatch failures
+#define BATCH_READ_FAILED -2
+
+typedef struct {
+    char text[BATCH_BLOCK_LINES][BATCH_SENTENCE_SIZE];   //Each command ending with ';'
+    char *keyword[BATCH_BLOCK_LINES][10];
+    int keywordLength[BATCH_BLOCK_LINES];
+    char *dates[BATCH_BLOCK_LINES];     //NULL when the command has too few fields
+    char *times[BATCH_BLOCK_LINES];
+    char *hours[BATCH_BLOCK_LINES];
+    unsigned char errors[BATCH_BLOCK_LINES];
+    int count;
+} BatchBlock;
+
+//One command of a batch chunk, parsed but not yet stored
+typedef struct {
+    int errors;         //INVALID_* bits, booking is only filled when 0
+    Booking booking;
+} ParsedCommand;
+
+//A run of whole commands of a batch file, parsed by one thread
+typedef struct {
+    const char *start;
+    const char *end;
+    ParsedCommand *commands;
+    int count;
+    int allocated;
+    int failed;
+} BatchChunk;
+
+typedef struct {
+    BatchChunk *chunks;
+    int chunk_num;
+    int build;          //Also build the bookings, not only their INVALID_* bits
+    atomic_int next_chunk;
+} BatchParseJob;
+
+//Threads that parse every window of one batch along with the caller. They
+//are started the first time a window has chunks for them and kept, asleep
+//between windows, until the batch is done.
+typedef struct {
+    pthread_t threads[BATCH_MAX_THREADS];
+    BatchBlock *blocks[BATCH_MAX_THREADS + 1];  //Block of each worker, the caller's last
+    int thread_num;
+    pthread_mutex_t lock;
+    pthread_cond_t posted;      //A window was posted, or stop was set
+    pthread_cond_t idle;        //No worker is parsing any more
+    BatchParseJob *job;         //Window being parsed, NULL between windows
+    int generation;             //Windows posted so far
+    int active;                 //Workers parsing job
+    int stop;
+} BatchPool;
+
+typedef struct {
+    BatchPool *pool;
+    int index;
+} BatchWorker;
+
+//One line of a queryAvailability file
+typedef struct {
+    char date[11];
+    char startTime[6];
+    char endTime[6];
+    int first;      //Slot range, valid only if valid is set
+    int last;
+    int valid;
+    int freeUnits[RESOURCE_NUM];
+} AvailabilityQuery;
+
+typedef struct {
+    int member_id;
+    int first;  //first and last index of this member's chain in records[]
+    int last;
+} MemberGroup;
 
 void readFromUserInput();
-void executeCommand(char *keyword[],int keywordLength );
-
-int checkForMemberName(char *name);
-int checkForaddParking(char *keyword[],int keywordLength);
-int checkForAddReservation(char *keyword[],int keywordLength) ;
-int checkForAddEvent(char *keyword[],int keywordLength);
-int checkForBookEssentials(char *keyword[],int keywordLength);
+int executeCommand(char *keyword[],int keywordLength, int fieldErrors);
+int parseCommand(char *keyword[], int keywordLength, int fieldErrors, Booking *booking);
+int validateCommand(char *keyword[], int keywordLength, int fieldErrors);
+void printValidationError(int errors);
 
 void insertEssentials(Booking *booking, int numOfEssentials, char *keyword[],int isPair) ;
 void insertToLinklist(Booking *booking);
-void readBatchFile(char *filename);
+void appendNode(Node *node);
+void storeList(int siteId, Node ***listHead, Node ***listTail);
+void replayRecord(int kind, Booking *booking);
+int removeBooking(int bookingId);
+int updateBooking(const Booking *updated);
+int cancelCommand(char *keyword[], int keywordLength);
+void promoteReleased(const Booking *booking, const SlotUnits *units);
+int promoteWaitlisted(unsigned int mask, int first, int last);
+int growLiveCapacity(const int capacity[RESOURCE_NUM]);
+void printWaitlist();
+int printFiltered(char *keyword[], int keywordLength);
+int refreshAvailability();
+int queryRange(char *date, char *startTime, char *endTime, int *first, int *last);
+void printAvailability(const char *date, const char *startTime, const char *endTime, const int freeUnits[RESOURCE_NUM]);
+void queryAvailability(char *keyword[], int keywordLength);
+void queryAvailabilityFile(char *filename);
+int modifyCommand(char *keyword[], int keywordLength);
+void restoreBookings(Node *list);
+int saveBookings(const char *filename);
+void syncCurrentSite();
+void selectSite(int siteId);
+int addSite(char *keyword[], int keywordLength);
+void printSiteSummary();
+void printSiteResults(SiteResult *results);
+void shardBookings(char *mode, int workers);
+int storeBooking(Booking *booking);
+int setOnlineAdmission(int enable);
+void printCommandResult(int result);
+void readBatchFile(char *filename, int strict);
+int fillBatchBlock(BatchBlock *block, const char **cursor, const char *limit);
+const char* batchBoundary(const char *p, const char *limit);
+void parseBatchChunks(BatchParseJob *job, BatchBlock **block);
+void batchPoolInit(BatchPool *pool);
+void* batchPoolWorker(void *arg);
+void parseBatchWindow(BatchPool *pool, BatchParseJob *job, int threadNum);
+void batchPoolStop(BatchPool *pool);
+int runBatchWindow(BatchPool *pool, const char *window, const char *windowEnd, int execute, int *commands, int *invalid, int *firstInvalid);
+int runBatch(int fd, int execute, int *firstInvalid);
+char* stripArgument(char *argument);
+const char* serveCommand(char *command);
 
-int commonInspectItem(char *keyword[],int keywordLength) ;
-int checkForDate(char *date);
-int checkForTime(char *time);
-int checkForHours(char *hours) ;
 int checkForEssentials(char* keyword[],int keyLength);
+int checkForQuantities(char* keyword[],int keyLength);
+int hasSpaceQuantity(char* keyword[],int keyLength);
+int knownResource(const char *name, int length, int allowSpace);
+int parseQuantity(const char *digits, int length);
+void insertQuantities(Booking *booking, int numOfItems, char *keyword[]);
 
 void printLinklist(Node* list);
 void printFormattedAcceptedBookings(Node* accepted, char *algoName,int bitModel);
-void processBookings(Node* head, int (*printBookingsFunc)(Node*, Node**, Node**), char *algoName, int acceptedModel) ;
+void printBookingRow(AioWriter *out, const Booking *b, int indent);
+int compareMemberGroup(const void *a, const void *b);
+void processBookings(Node* head, const SchedulePolicy *policy, int acceptedModel) ;
+void printBreakdown(AioWriter *out, const SchedulePolicy *policy);
+void exportHeatmap(char *filename);
 
 
 Node *head = NULL;
+Node *tail = NULL;   //Last node of head, so inserts do not walk the list
+Node *spareNodes = NULL;    //Nodes of cancelled bookings, reused by insertToLinklist
+
+//Live FCFS slot state used by online admission
+SlotIndex liveIndex;
+int onlineAdmission = 0;
 
 const char *validMembers[] = {"member_A", "member_B", "member_C", "member_D", "member_E"};
-const char *validEssentials[] = {"battery", "cable", "locker","umbrella","InflationService","valetpark"};
+//Spellings the essentials check always let through without booking anything,
+//kept so batch files written against it read the same. Resources come from the catalog.
+const char *legacyEssentials[] = {"valetpark"};
 
 int main() {
     printf("~~ WELCOME TO PolyU ~~\n");
 
+    //Load the member registry, falling back to the default members
+    if (load_member_file(MEMBER_FILE) <= 0) {
+        int i;
+        for (i = 0; i < (int)(sizeof(validMembers) / sizeof(validMembers[0])); i++) {
+            if (member_register(validMembers[i]) < 0) printf("-> Could not register member %s.\n", validMembers[i]);
+        }
+    }
+
+    //Load the resource catalog, falling back to the built-in resources
+    if (catalog_load(CATALOG_FILE) <= 0) catalog_defaults();
+    catalog_capacities(resource_capacity);
+
+    //The default site keeps the catalog capacities, more sites come from the site file
+    site_register(DEFAULT_SITE_NAME, resource_capacity);
+    load_site_file(SITE_FILE);
+
+    //Restore the booking stores saved by the last saveSnapshot
+    Node *restoredList = NULL, *restoredTail = NULL;
+    int restored = load_snapshot(SNAPSHOT_FILE, &restoredList, &restoredTail);
+    restoreBookings(restoredList);
+    if (restored >= 0) printf("-> %d booking(s) restored from %s.\n", restored, SNAPSHOT_FILE);
+    //Replay bookings logged after that snapshot, then keep logging new ones
+    int replayed = wal_replay(WAL_FILE, replayRecord);
+    if (replayed > 0) printf("-> %d log record(s) recovered from %s.\n", replayed, WAL_FILE);
+    wal_open(WAL_FILE);
+
     while (1) {
         char line[100];
         printf("Please enter booking:\n");
@@ -53,43 +231,186 @@ int main() {
             keywordLength++;
             word = strtok(NULL, " ");
         }
+        if (keywordLength == 0) continue;
+        //Single word commands may end with ';' like the others
+        if (keywordLength == 1) stripArgument(keyword[0]);
 
         if ((strcmp(keyword[0], "addParking") == 0) ||
             (strcmp(keyword[0], "addReservation") == 0) ||
             (strcmp(keyword[0], "bookEssentials") == 0) ||
             (strcmp(keyword[0], "addEvent") == 0))
-            { executeCommand(keyword,keywordLength);  }
+            {
+                int result = executeCommand(keyword,keywordLength,-1);
+                printCommandResult(result);
+                //storeBooking issued the newest id to this booking
+                if (result != COMMAND_INVALID) printf("-> Booking id %d.\n", booking_next_id - 1);
+            }
 
         else if (strcmp(keyword[0], "addBatch") == 0) {
-            readBatchFile(keyword[1]);
-
-        } else if (strcmp(keyword[0], "printBookings") == 0) {
-            if (strcmp(keyword[1], "-fcfs;") == 0) {
-                processBookings(head, print_bookings_fcfs, "FCFS", 1);
-            } else if (strcmp(keyword[1], "-prio;") == 0) {
-                processBookings(head, print_bookings_priority, "PRIO", 1);
-            } else if (strcmp(keyword[1], "-ALL;") == 0) {
-                int invalid_requests;
-                printf("*** Parking Booking Manager - Summary Report ***\n\n");
-                printf("Performance:\n\n");
-
-                // Process FCFS bookings
-                Node *accepted_fcfs = NULL, *rejected_fcfs = NULL;
-                invalid_requests = print_bookings_fcfs(head, &accepted_fcfs, &rejected_fcfs);
-                printf(" For FCFS:\n");
-                gen_report(stdout, head, accepted_fcfs, rejected_fcfs, invalid_requests);
-                free_list(accepted_fcfs);
-                free_list(rejected_fcfs);
-
-                // Process PRIO bookings
-                Node *accepted_prio = NULL, *rejected_prio = NULL;
-                invalid_requests = print_bookings_priority(head, &accepted_prio, &rejected_prio);
-                printf(" For PRIO:\n");
-                gen_report(stdout, head, accepted_prio, rejected_prio, invalid_requests);
-                free_list(accepted_prio);
-                free_list(rejected_prio);
+            readBatchFile(keyword[1], keywordLength > 2 && strcmp(keyword[2], "-strict;") == 0);
+
+        } else if (strcmp(keyword[0], "printBookings") == 0 && keywordLength > 1) {
+            char *mode = stripArgument(keyword[1]);
+            const SchedulePolicy *policy = schedule_policy_lookup(mode);
+            int p;
+            if (policy) {
+                processBookings(head, policy, 1);
+            } else if (strcmp(mode, "ALL") == 0) {
+                //The report of one policy is written out while the next one is scheduled
+                AioWriter out;
+                fflush(stdout);
+                aio_writer_open(&out, STDOUT_FILENO);
+                aio_writer_printf(&out, "*** Parking Booking Manager - Summary Report ***\n\n");
+                aio_writer_printf(&out, "Performance:\n\n");
+                for (p = 0; p < SCHEDULE_SUMMARY_POLICIES; p++) {
+                    Node *accepted = NULL, *rejected = NULL;
+                    ScheduleTotals totals;
+                    run_schedule(&schedule_policies[p], head, &accepted, &rejected, &totals);
+                    aio_writer_printf(&out, " For %s:\n", schedule_policies[p].title);
+                    gen_report(&out, &totals, accepted);
+                    free_list(accepted);
+                    free_list(rejected);
+                    aio_writer_flush(&out);
+                }
+                aio_writer_close(&out);
+            } else if (strcmp(mode, "STATS") == 0) {
+                AioWriter out;
+                fflush(stdout);
+                aio_writer_open(&out, STDOUT_FILENO);
+                aio_writer_printf(&out, "*** Parking Booking Manager - Utilization Breakdown ***\n\n");
+                for (p = 0; p < SCHEDULE_SUMMARY_POLICIES; p++) printBreakdown(&out, &schedule_policies[p]);
+                aio_writer_close(&out);
+            } else if (strcmp(mode, "SITES") == 0) {
+                printSiteSummary();
+            } else {
+                printf("-> Please check your command again.\n");
+            }
+        } else if (strcmp(keyword[0], "exportHeatmap") == 0 && keywordLength > 1) {
+            exportHeatmap(stripArgument(keyword[1]));
+        } else if (strcmp(keyword[0], "cancelBooking") == 0) {
+            if (!cancelCommand(keyword, keywordLength)) printf("-> Please check your command again.\n");
+        } else if (strcmp(keyword[0], "modifyBooking") == 0) {
+            if (!modifyCommand(keyword, keywordLength)) printf("-> Please check your command again.\n");
+        } else if (strcmp(keyword[0], "queryAvailability") == 0 && keywordLength > 1) {
+            queryAvailability(keyword, keywordLength);
+        } else if (strcmp(keyword[0], "printWaitlist") == 0) {
+            printWaitlist();
+        } else if (strcmp(keyword[0], "print") == 0 && keywordLength > 1) {
+            if (!printFiltered(keyword, keywordLength)) printf("-> Please check your command again.\n");
+        } else if (strcmp(keyword[0], "saveSnapshot") == 0) {
+            char *filename = keywordLength > 1 ? stripArgument(keyword[1]) : SNAPSHOT_FILE;
+            int saved = saveBookings(filename);
+            if (saved < 0) printf("-> Could not write snapshot: %s\n", filename);
+            else printf("-> %d booking(s) saved to %s.\n", saved, filename);
+        } else if (strcmp(keyword[0], "loadSnapshot") == 0 && keywordLength > 1) {
+            char *filename = stripArgument(keyword[1]);
+            int i, empty = 1;
+            syncCurrentSite();
+            for (i = 0; i < site_count; i++) {
+                if (sites[i].head != NULL) empty = 0;
+            }
+            if (!empty) {
+                printf("-> Snapshots can only be loaded into an empty booking store.\n");
+            } else {
+                Node *loadedList = NULL, *loadedTail = NULL;
+                int loaded = load_snapshot(filename, &loadedList, &loadedTail);
+                restoreBookings(loadedList);
+                if (loaded < 0) printf("-> Could not load snapshot: %s\n", filename);
+                else printf("-> %d booking(s) restored from %s.\n", loaded, filename);
+                //Recovery replays the log over the default snapshot, so the loaded
+                //stores become that checkpoint before anything else is logged
+                if (loaded >= 0 && saveBookings(SNAPSHOT_FILE) < 0) printf("-> Could not write snapshot: %s\n", SNAPSHOT_FILE);
+            }
+        } else if (strcmp(keyword[0], "startServer") == 0 && keywordLength > 1) {
+            char *socketPath = stripArgument(keyword[1]);
+            printf("-> Serving bookings on %s, send %s; to stop.\n", socketPath, SERVER_SHUTDOWN_COMMAND);
+            fflush(stdout);
+            if (!run_server(socketPath, serveCommand)) printf("-> Could not start server on %s\n", socketPath);
+            else printf("-> Server stopped.\n");
+        } else if (strcmp(keyword[0], "setAdmission") == 0 && keywordLength > 1) {
+            char *mode = stripArgument(keyword[1]);
+            if (strcmp(mode, "online") == 0) {
+                if (setOnlineAdmission(1)) printf("-> Online admission enabled.\n");
+                else printf("-> Memory allocation failed while building slot index.\n");
+            } else if (strcmp(mode, "off") == 0) {
+                setOnlineAdmission(0);
+                printf("-> Online admission disabled.\n");
+            } else {
+                printf("-> Please check your command again.\n");
+            }
+        } else if (strcmp(keyword[0], "stressReserve") == 0) {
+            int threads = keywordLength > 1 ? atoi(stripArgument(keyword[1])) : 16;
+            if (threads < 1) threads = 1;
+            if (!slot_stress_test(threads, 20000)) printf("-> Stress test FAILED.\n");
+        } else if (strcmp(keyword[0], "benchSlots") == 0) {
+            int threads = keywordLength > 1 ? atoi(stripArgument(keyword[1])) : 32;
+            slot_benchmark(threads < 1 ? 1 : threads);
+        } else if (strcmp(keyword[0], "setPlacement") == 0 && keywordLength > 1) {
+            char *policy = stripArgument(keyword[1]);
+            int i, selected = -1;
+            for (i = 0; i < PLACEMENT_NUM; i++) {
+                if (strcmp(policy, PLACEMENT_NAMES[i]) == 0) selected = i;
+            }
+            if (selected < 0) {
+                printf("-> Please check your command again.\n");
+            } else {
+                placement_policy = selected;
+                printf("-> Units will be placed %s.\n", PLACEMENT_NAMES[selected]);
+            }
+        } else if (strcmp(keyword[0], "benchPlacement") == 0) {
+            int requests = keywordLength > 1 ? atoi(stripArgument(keyword[1])) : 400;
+            int rounds = keywordLength > 2 ? atoi(stripArgument(keyword[2])) : 200;
+            placement_benchmark(requests < 1 ? 1 : requests, rounds < 1 ? 1 : rounds);
+        } else if (strcmp(keyword[0], "addSite") == 0 && keywordLength > 1) {
+            if (!addSite(keyword, keywordLength)) printf("-> Please check your command again.\n");
+        } else if (strcmp(keyword[0], "useSite") == 0 && keywordLength > 1) {
+            char *name = stripArgument(keyword[1]);
+            int siteId = site_lookup(name);
+            if (siteId < 0) {
+                printf("-> Site not found: %s\n", name);
+            } else {
+                selectSite(siteId);
+                printf("-> Using site %s.\n", name);
             }
+        } else if (strcmp(keyword[0], "loadSites") == 0 && keywordLength > 1) {
+            char *filename = stripArgument(keyword[1]);
+            int loaded = load_site_file(filename);
+            if (loaded < 0) printf("-> Could not open file: %s\n", filename);
+            else printf("-> %d site(s) loaded, %d registered.\n", loaded, site_count);
+            //Capacities of the current site may have been redefined
+            selectSite(current_site);
+        } else if (strcmp(keyword[0], "shardBookings") == 0 && keywordLength > 1) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            int workers = keywordLength > 2 ? atoi(stripArgument(keyword[2])) : (int)cpus;
+            shardBookings(stripArgument(keyword[1]), workers < 1 ? 1 : workers);
+        } else if (strcmp(keyword[0], "setTransport") == 0 && keywordLength > 1) {
+            char *transport = stripArgument(keyword[1]);
+            if (strcmp(transport, "ring") == 0) resource_transport = TRANSPORT_RING;
+            else if (strcmp(transport, "pipe") == 0) resource_transport = TRANSPORT_PIPE;
+            else transport = NULL;
+            if (transport) printf("-> Resource managers will use %s transport.\n", transport);
+            else printf("-> Please check your command again.\n");
+        } else if (strcmp(keyword[0], "setIo") == 0 && keywordLength > 1) {
+            char *backend = stripArgument(keyword[1]);
+            int selected = 0;
+            if (strcmp(backend, "uring") == 0) selected = aio_select(AIO_BACKEND_URING);
+            else if (strcmp(backend, "threads") == 0) selected = aio_select(AIO_BACKEND_THREAD);
+            if (selected) printf("-> Batch input and report output will use %s.\n", aio_backend_name());
+            else if (strcmp(backend, "uring") == 0) printf("-> io_uring is not available, using %s.\n", aio_backend_name());
+            else printf("-> Please check your command again.\n");
+        } else if (strcmp(keyword[0], "benchTransport") == 0) {
+            int roundTrips = keywordLength > 1 ? atoi(stripArgument(keyword[1])) : 100000;
+            if (roundTrips < 1) roundTrips = 1;
+            printf("%-10s%-12s%-16s\n", "Transport", "Requests", "ns/round trip");
+            benchmark_transport(TRANSPORT_PIPE, roundTrips);
+            benchmark_transport(TRANSPORT_RING, roundTrips);
+        } else if (strcmp(keyword[0], "loadMembers") == 0 && keywordLength > 1) {
+            char *filename = stripArgument(keyword[1]);
+            int loaded = load_member_file(filename);
+            if (loaded < 0) printf("-> Could not open file: %s\n", filename);
+            else printf("-> %d member(s) loaded, %d registered.\n", loaded, member_count);
         } else if (strcmp(keyword[0], "endProgram") == 0) {
+            wal_commit();
             printf("-> Bye!\n");
             break;
         } else if (strcmp(keyword[0], "print") == 0) {
@@ -97,20 +418,62 @@ int main() {
         } else {
             printf("-> Please check your command again.\n");
         }
+
+        //Group commit: bookings of this command become durable together
+        wal_commit();
     }
 
     return 0;
 }
 
-void processBookings(Node* head, int (*printBookingsFunc)(Node*, Node**, Node**), char *algoName, int acceptedModel) {
+void processBookings(Node* head, const SchedulePolicy *policy, int acceptedModel) {
     Node *accepted = NULL, *rejected = NULL;
-    printBookingsFunc(head, &accepted, &rejected);
-    printFormattedAcceptedBookings(accepted, algoName, acceptedModel);
-    printFormattedAcceptedBookings(rejected, algoName, !acceptedModel);
+    run_schedule(policy, head, &accepted, &rejected, NULL);
+    printFormattedAcceptedBookings(accepted, (char*)policy->title, acceptedModel);
+    printFormattedAcceptedBookings(rejected, (char*)policy->title, !acceptedModel);
     free_list(accepted);
     free_list(rejected);
 }
 
+//The breakdown is handed to out, which writes it while the next policy is scheduled
+void printBreakdown(AioWriter *out, const SchedulePolicy *policy) {
+    Node *accepted = NULL, *rejected = NULL;
+    Analytics analytics;
+    ScheduleTotals totals;
+    run_schedule(policy, head, &accepted, &rejected, &totals);
+    aio_writer_printf(out, " For %s:\n", policy->title);
+    if (analyze_bookings(&totals, accepted, &analytics)) {
+        gen_breakdown_report(out, &analytics);
+        free_analytics(&analytics);
+    } else {
+        aio_writer_printf(out, "-> Memory allocation failed while analyzing bookings.\n");
+    }
+    free_list(accepted);
+    free_list(rejected);
+    aio_writer_flush(out);
+}
+
+//Export the slot state left by the last printBookings run as CSV, or binary for *.bin
+void exportHeatmap(char *filename) {
+    if (!slot_occupancy_valid) {
+        printf("-> No schedule to export, please run printBookings first.\n");
+        return;
+    }
+    int len = strlen(filename);
+    int ok;
+    if (len > 4 && strcmp(filename + len - 4, ".bin") == 0) ok = export_heatmap_binary(filename, slot_occupancy);
+    else ok = export_heatmap_csv(filename, slot_occupancy);
+    if (!ok) {
+        printf("-> Could not write file: %s\n", filename);
+        return;
+    }
+    AioWriter out;
+    fflush(stdout);
+    aio_writer_open(&out, STDOUT_FILENO);
+    aio_writer_printf(&out, "*** Time Slot Heatmap - %s ***\n", filename);
+    gen_heatmap_summary(&out, slot_occupancy);
+    aio_writer_close(&out);
+}
 
 void printLinklist(Node* list) {
     if (list == NULL) {
@@ -125,18 +488,20 @@ void printLinklist(Node* list) {
     while (current != NULL) {
         Booking *b = &current->booking;
         printf("Booking %d:", count++);
-        printf("  Member: %s", b->member);
+        printf("  Member: %s", member_name(b->member_id));
         printf("  Date: %s", b->date);
         printf("  Time: %s", b->time);
         printf("  Duration: %.1f", b->duration);
         printf("  Priority: %d", b->priority);
+        int counts[RESOURCE_NUM], r;
+        resource_counts(b, counts);
+        if (counts[SPACE] > 1) printf("  Spaces: %d", counts[SPACE]);
         printf("  Essentials:");
-        if (b->battery) printf("    - Battery");
-        if (b->cable) printf("    - Cable");
-        if (b->locker) printf("    - Locker");
-        if (b->umbrella) printf("    - Umbrella");
-        if (b->valet) printf("    - Valet Park");
-        if (b->inflation) printf("    - Inflation Service");
+        //Group events also show how many units of an essential they hold
+        for (r = SPACE + 1; r < resource_count; r++) {
+            if (counts[r] > 1) printf("    - %s x%d", resource_catalog[r].label, counts[r]);
+            else if (counts[r]) printf("    - %s", resource_catalog[r].label);
+        }
         current = current->next;
         printf("\n");
     }
@@ -157,426 +522,1429 @@ void printFormattedAcceptedBookings(Node* accepted, char *algoName,int bitModel)
     printf("%s ***\n", algoName);
 
 
+    //Group bookings by member in one pass. Only members that appear get a
+    //group, and each group keeps a chain of indexes into records[], so
+    //bookings are referenced by pointer and never copied
+    static int *memberGroup = NULL;    //member id -> group index, -1 if none
+    static int memberGroupSize = 0;
+    if (memberGroupSize < member_count) {
+        int *newGroup = realloc(memberGroup, member_count * sizeof(int));
+        if (!newGroup) {
+            printf("-> Memory allocation failed while grouping bookings.\n");
+            return;
+        }
+        memberGroup = newGroup;
+        while (memberGroupSize < member_count) memberGroup[memberGroupSize++] = -1;
+    }
 
-    Booking memberRecord[5][100];
-    int A_length = 0, B_length = 0, C_length = 0, D_length = 0, E_length = 0;
-
+    MemberGroup *groups = NULL;
+    int groupLength = 0, groupCapacity = 0;
+    const Booking **records = NULL;
+    int *nextRecord = NULL;
+    int recordLength = 0, recordCapacity = 0;
+    int failed = 0;
 
     Node* current = accepted;
-    while (current != NULL) {
-        Booking* b = &current->booking;
-
-        if (strcmp(validMembers[0], b->member) == 0) {memberRecord[0][A_length] = *b; A_length++; }
-        else if (strcmp(validMembers[1], b->member) == 0) {memberRecord[1][B_length] = *b; B_length++; }
-        else if (strcmp(validMembers[2], b->member) == 0) {memberRecord[2][C_length] = *b; C_length++; }
-        else if (strcmp(validMembers[3], b->member) == 0) {memberRecord[3][D_length] = *b; D_length++; }
-        else if (strcmp(validMembers[4], b->member) == 0) {memberRecord[4][E_length] = *b; E_length++; }
+    while (current != NULL && !failed) {
+        const Booking* b = &current->booking;
+        int id = b->member_id;
+
+        if (id >= 0 && id < member_count) {
+            if (recordLength == recordCapacity) {
+                recordCapacity = recordCapacity ? recordCapacity * 2 : 64;
+                const Booking **newRecords = realloc(records, recordCapacity * sizeof(*records));
+                int *newNext = realloc(nextRecord, recordCapacity * sizeof(*nextRecord));
+                if (newRecords) records = newRecords;
+                if (newNext) nextRecord = newNext;
+                if (!newRecords || !newNext) { failed = 1; break; }
+            }
+            int g = memberGroup[id];
+            if (g < 0) {
+                if (groupLength == groupCapacity) {
+                    groupCapacity = groupCapacity ? groupCapacity * 2 : 16;
+                    MemberGroup *newGroups = realloc(groups, groupCapacity * sizeof(*groups));
+                    if (!newGroups) { failed = 1; break; }
+                    groups = newGroups;
+                }
+                g = groupLength++;
+                memberGroup[id] = g;
+                groups[g].member_id = id;
+                groups[g].first = recordLength;
+            } else {
+                nextRecord[groups[g].last] = recordLength;
+            }
+            records[recordLength] = b;
+            nextRecord[recordLength] = -1;
+            groups[g].last = recordLength;
+            recordLength++;
+        }
 
         current = current->next;
     }
 
-    int i,j,currentLength;
-    for (i = 0; i<5 ; i++) {
-        printf("%s has the following bookings:\n",validMembers[i]);
-        printf("%-15s%-8s%-8s%-15s%-10s\n","Date","Start","End","Type","Device");
-        printf("====================================================================================\n");
+    //Reset only the members touched by this report
+    int i;
+    for (i = 0; i < groupLength; i++) memberGroup[groups[i].member_id] = -1;
 
-        if (i == 0) {currentLength = A_length;}
-        else if (i == 1) {currentLength = B_length;}
-        else if (i == 2) {currentLength = C_length;}
-        else if (i == 3) {currentLength = D_length;}
-        else if (i == 4) {currentLength = E_length;}
+    if (failed) {
+        printf("-> Memory allocation failed while grouping bookings.\n");
+        free(groups);
+        free(records);
+        free(nextRecord);
+        return;
+    }
 
-        for (j = 0;j<currentLength;j++) {
+    //Members are listed in registry order
+    qsort(groups, groupLength, sizeof(*groups), compareMemberGroup);
 
-            char endHourStr[6];
-            snprintf(endHourStr, sizeof(endHourStr), "%02d:00",
-         (atoi(memberRecord[i][j].time) + (int)(memberRecord[i][j].duration)) % 24);
+    //Rows are formatted into one buffer while the previous one is written out
+    AioWriter out;
+    fflush(stdout);
+    aio_writer_open(&out, STDOUT_FILENO);
+    for (i = 0; i<groupLength ; i++) {
+        aio_writer_printf(&out, "%s has the following bookings:\n",member_name(groups[i].member_id));
+        aio_writer_printf(&out, "%-15s%-8s%-8s%-15s%-12s%-10s\n","Date","Start","End","Type","Space","Device");
+        aio_writer_printf(&out, "====================================================================================\n");
 
-            char *type;
-            switch (memberRecord[i][j].priority) {
-                case 1: type = "Essentials"; break;
-                case 2: type = "Parking"; break;
-                case 3: type = "Reservation"; break;
-                case 4: type = "Event"; break;
-            }
-
-            int count = 0;
-            char *selected[6] = {0};
-            if (memberRecord[i][j].battery) { selected[count] = "battery"; count++; }
-            if (memberRecord[i][j].cable) { selected[count] = "cable"; count++; }
-            if (memberRecord[i][j].locker) {selected[count] = "locker"; count++; }
-            if (memberRecord[i][j].umbrella) {selected[count] = "umbrella"; count++; }
-            if (memberRecord[i][j].valet) { selected[count] = "valet"; count++; }
-            if (memberRecord[i][j].inflation) { selected[count] = "inflation"; count++; }
-
-            if (!count) {
-                printf("%-15s%-8s%-8s%-15s%-10s\n", memberRecord[i][j].date, memberRecord[i][j].time, endHourStr, type, "-");
-            } else if (count == 1) {
-                printf("%-15s%-8s%-8s%-15s%-10s\n", memberRecord[i][j].date, memberRecord[i][j].time, endHourStr, type, selected[0]);
-            } else if (count == 2) {
-                printf("%-15s%-8s%-8s%-15s%-10s\n", memberRecord[i][j].date, memberRecord[i][j].time, endHourStr, type, selected[0]);
-                printf("%-15s%-8s%-8s%-15s%-10s\n", "", "", "", "", selected[1]);
-            } else {
-                printf("%-15s%-8s%-8s%-15s%-10s\n", memberRecord[i][j].date, memberRecord[i][j].time, endHourStr, type, "*");
-            }
+        int j;
+        for (j = groups[i].first; j >= 0; j = nextRecord[j]) {
+            printBookingRow(&out, records[j], 0);
         }
 
-        printf("\n");
+        aio_writer_printf(&out, "\n");
 
     }
 
-    printf("    - End -\n");
-    printf("====================================================================================\n");
+    free(groups);
+    free(records);
+    free(nextRecord);
+
+    aio_writer_printf(&out, "    - End -\n");
+    aio_writer_printf(&out, "====================================================================================\n");
+    aio_writer_close(&out);
+}
+
+void printBookingRow(AioWriter *out, const Booking *b, int indent) {
+    //indent is the width of the columns the caller printed before the row
+    //End time of the slot range the booking was scheduled on
+    int endMinute = (time_to_slot(b->time) + duration_to_slots(b->duration)) * SLOT_MINUTES % (24 * 60);
+    char endHourStr[12];
+    snprintf(endHourStr, sizeof(endHourStr), "%02d:%02d", endMinute / 60, endMinute % 60);
+
+    char *type = "";
+    switch (b->priority) {
+        case 1: type = "Essentials"; break;
+        case 2: type = "Parking"; break;
+        case 3: type = "Reservation"; break;
+        case 4: type = "Event"; break;
+    }
+
+    //Units are numbered from 1 for display, "-" when none was assigned; a
+    //group holds the block of units first-last, or units from first on that
+    //are not adjacent, shown as first.. xcount
+    int counts[RESOURCE_NUM];
+    resource_counts(b, counts);
+    char space[32] = "-";
+    if (counts[SPACE] && b->units[SPACE] >= 0) {
+        if (counts[SPACE] > 1 && (b->scattered >> SPACE & 1)) snprintf(space, sizeof(space), "%d.. x%d", b->units[SPACE] + 1, counts[SPACE]);
+        else if (counts[SPACE] > 1) snprintf(space, sizeof(space), "%d-%d", b->units[SPACE] + 1, b->units[SPACE] + counts[SPACE]);
+        else snprintf(space, sizeof(space), "%d", b->units[SPACE] + 1);
+    }
+
+    int count = 0;
+    int resources[RESOURCE_NUM];
+    int r;
+    for (r = SPACE + 1; r < resource_count; r++) {
+        if (counts[r]) resources[count++] = r;
+    }
+    char devices[2][CATALOG_NAME_LEN + 24];
+    int i;
+    for (i = 0; i < count && i < 2; i++) {
+        r = resources[i];
+        const char *selected = resource_catalog[r].name;
+        if (b->units[r] >= 0 && counts[r] > 1 && (b->scattered >> r & 1)) snprintf(devices[i], sizeof(devices[i]), "%s#%d.. x%d", selected, b->units[r] + 1, counts[r]);
+        else if (b->units[r] >= 0 && counts[r] > 1) snprintf(devices[i], sizeof(devices[i]), "%s#%d-%d", selected, b->units[r] + 1, b->units[r] + counts[r]);
+        else if (b->units[r] >= 0) snprintf(devices[i], sizeof(devices[i]), "%s#%d", selected, b->units[r] + 1);
+        else if (counts[r] > 1) snprintf(devices[i], sizeof(devices[i]), "%s x%d", selected, counts[r]);
+        else snprintf(devices[i], sizeof(devices[i]), "%s", selected);
+    }
+
+    if (!count) {
+        aio_writer_printf(out, "%-15s%-8s%-8s%-15s%-12s%-10s\n", b->date, b->time, endHourStr, type, space, "-");
+    } else if (count == 1) {
+        aio_writer_printf(out, "%-15s%-8s%-8s%-15s%-12s%-10s\n", b->date, b->time, endHourStr, type, space, devices[0]);
+    } else if (count == 2) {
+        aio_writer_printf(out, "%-15s%-8s%-8s%-15s%-12s%-10s\n", b->date, b->time, endHourStr, type, space, devices[0]);
+        aio_writer_printf(out, "%*s%-15s%-8s%-8s%-15s%-12s%-10s\n", indent, "", "", "", "", "", "", devices[1]);
+    } else {
+        aio_writer_printf(out, "%-15s%-8s%-8s%-15s%-12s%-10s\n", b->date, b->time, endHourStr, type, space, "*");
+    }
+}
+
+int compareMemberGroup(const void *a, const void *b) {
+    const MemberGroup *x = (const MemberGroup *)a;
+    const MemberGroup *y = (const MemberGroup *)b;
+    return (x->member_id > y->member_id) - (x->member_id < y->member_id);
 }
 
 void insertToLinklist(Booking *booking) {
-    Node *newNode = (Node *)malloc(sizeof(Node));
+    Node *newNode = spareNodes;
+    if (newNode) spareNodes = newNode->next;
+    else newNode = (Node *)malloc(sizeof(Node));
     if (!newNode) {
         printf("-> Memory allocation failed while inserting booking.\n");
         return;
     }
 
     newNode->booking = *booking;
-    newNode->next = NULL;
+    appendNode(newNode);
+}
 
-    if (head == NULL) {
-        head = newNode;
+//Append a node to the store of its site; the current site's store is head/tail
+void appendNode(Node *node) {
+    Node *prev;
+    if (node->booking.site_id != current_site) {
+        int siteId = node->booking.site_id;
+        prev = siteId >= 0 && siteId < site_count ? sites[siteId].tail : NULL;
+        site_append(siteId, node);
     } else {
-        Node *temp = head;
-        while (temp->next != NULL) {
-            temp = temp->next;
+        prev = tail;
+        node->next = NULL;
+        if (head == NULL) {
+            head = node;
+        } else {
+            tail->next = node;
         }
-        temp->next = newNode;
+        tail = node;
     }
+    booking_index_put(node, prev);
+    availability_invalidate();
 }
 
+//Head and tail of the store a site's bookings live in
+void storeList(int siteId, Node ***listHead, Node ***listTail) {
+    if (siteId == current_site) {
+        *listHead = &head;
+        *listTail = &tail;
+    } else {
+        *listHead = &sites[siteId].head;
+        *listTail = &sites[siteId].tail;
+    }
+}
 
-void executeCommand(char *keyword[],int keywordLength ) {
-    Booking booking;
-    if (strcmp(keyword[0], "addParking") == 0) {
-        if (checkForaddParking(keyword, keywordLength)) {
-            booking.parking_space = 1;
-            booking.priority = 2;
-
-            strncpy(booking.member, keyword[1], sizeof(booking.member) - 1);
-            booking.member[sizeof(booking.member) - 1] = '\0';
-
-            strcpy(booking.date, keyword[2]);
-            strcpy(booking.time, keyword[3]);
-            booking.duration = atoi(keyword[4]);
+//Apply one write-ahead log record during recovery
+void replayRecord(int kind, Booking *booking) {
+    if (kind == WAL_APPEND) insertToLinklist(booking);
+    else if (kind == WAL_CANCEL) removeBooking(booking->booking_id);
+    else if (kind == WAL_MODIFY) updateBooking(booking);
+}
 
-            insertEssentials(&booking,keywordLength-5,keyword,1);
+//Drop a booking from its store and hand its live units back, without
+//touching any other booking. Return 0 if there is no such booking.
+int removeBooking(int bookingId) {
+    BookingEntry *entry = booking_index_get(bookingId);
+    if (!entry) return 0;
+    Node *node = entry->node;
+    Booking freed = node->booking;
+    //The units outlive the entry until they are released
+    SlotUnits freedUnits = entry->units;
+    slot_units_init(&entry->units);
+    waitlist_remove(bookingId);
+
+    Node **listHead, **listTail;
+    storeList(node->booking.site_id, &listHead, &listTail);
+    if (entry->prev) entry->prev->next = node->next;
+    else *listHead = node->next;
+    if (node->next) booking_index_get(node->next->booking.booking_id)->prev = entry->prev;
+    else *listTail = entry->prev;
+
+    //Snapshot nodes share one allocation, so cancelled nodes are kept for reuse
+    booking_index_remove(bookingId);
+    node->next = spareNodes;
+    spareNodes = node;
+    //The last schedule still counts the booking
+    slot_occupancy_valid = 0;
+    availability_invalidate();
+
+    if (onlineAdmission && freed.site_id == current_site) {
+        release_booking(&liveIndex, &freed, &freedUnits);
+        promoteReleased(&freed, &freedUnits);
+    }
+    slot_units_free(&freedUnits);
+    return 1;
+}
 
-            insertToLinklist(&booking);
+//Offer the units a booking just gave back to the waitlist
+void promoteReleased(const Booking *booking, const SlotUnits *units) {
+    int start_day, end_day, start_slot, end_slot;
+    unsigned int mask = 0;
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (units->unit[r] >= 0) mask |= 1u << r;
+    }
+    if (!mask || !booking_slot_range(booking, &start_day, &end_day, &start_slot, &end_slot)) return;
+    promoteWaitlisted(mask, start_day * TIME_SLOT_PER_DAY + start_slot, end_day * TIME_SLOT_PER_DAY + end_slot);
+}
 
+//Admit waiting bookings that could use capacity freed on the resources of
+//mask over slots [first, last], earliest booking first. The waitlist only
+//yields bookings filed on those resources and days. Return the number promoted.
+int promoteWaitlisted(unsigned int mask, int first, int last) {
+    int *ids;
+    int n = waitlist_candidates(mask, first / TIME_SLOT_PER_DAY, last / TIME_SLOT_PER_DAY, &ids);
+    if (n <= 0) {
+        if (n == 0) free(ids);
+        return 0;
+    }
 
+    int i, promoted = 0;
+    for (i = 0; i < n; i++) {
+        BookingEntry *entry = booking_index_get(ids[i]);
+        if (!entry) {
+            waitlist_remove(ids[i]);
+            continue;
         }
-    }else if (strcmp(keyword[0], "addReservation") == 0) {
-
-        if (checkForAddReservation(keyword, keywordLength)) {
-            booking.parking_space = 1;
-            booking.priority = 3;
+        //Bookings on the same day that miss the freed slots cannot fit now either
+        int start_day, end_day, start_slot, end_slot;
+        if (!booking_slot_range(&entry->node->booking, &start_day, &end_day, &start_slot, &end_slot)) continue;
+        if (start_day * TIME_SLOT_PER_DAY + start_slot > last || end_day * TIME_SLOT_PER_DAY + end_slot < first) continue;
+
+        if (admit_booking(&liveIndex, &entry->node->booking, &entry->units) != ADMIT_ACCEPTED) continue;
+        waitlist_remove(ids[i]);
+        availability_invalidate();
+        promoted++;
+        printf("-> Booking %d promoted from the waitlist.\n", ids[i]);
+    }
+    free(ids);
+    return promoted;
+}
 
-            strncpy(booking.member, keyword[1], sizeof(booking.member) - 1);
-            booking.member[sizeof(booking.member) - 1] = '\0';
+//New capacities of the current site under online admission. Growth keeps
+//every admitted booking and offers the new units to the waitlist; a shrink
+//needs a rebuild. Return 0 if the live index could not be grown.
+int growLiveCapacity(const int capacity[RESOURCE_NUM]) {
+    int old[RESOURCE_NUM];
+    memcpy(old, liveIndex.capacity, sizeof(old));
+    if (!slot_index_grow(&liveIndex, capacity)) return 0;
+    memcpy(resource_capacity, capacity, sizeof(resource_capacity));
+    slot_occupancy_valid = 0;
+    availability_invalidate();
+
+    unsigned int mask = 0;
+    int r;
+    for (r = 0; r < RESOURCE_NUM; r++) {
+        if (capacity[r] > old[r]) mask |= 1u << r;
+    }
+    if (mask) promoteWaitlisted(mask, 0, SLOT_HORIZON - 1);
+    return 1;
+}
 
-            strcpy(booking.date, keyword[2]);
-            strcpy(booking.time, keyword[3]);
-            booking.duration = atoi(keyword[4]);
+//Bring the availability trees up to date: the live index under online
+//admission, otherwise an FCFS schedule of the current site's store, which
+//makes the same decisions as the FCFS policy of run_schedule. Return 0 on failure.
+int refreshAvailability() {
+    if (availability_valid) return 1;
+    if (onlineAdmission) return availability_build(&liveIndex);
+
+    SlotIndex index;
+    if (!slot_index_init(&index, resource_capacity)) return 0;
+    Node *current;
+    for (current = head; current != NULL; current = current->next) {
+        admit_booking(&index, &current->booking, NULL);
+    }
+    int ok = availability_build(&index);
+    slot_index_free(&index);
+    return ok;
+}
 
-            insertEssentials(&booking,keywordLength-5,keyword,1);
+//Slots a booking from startTime to endTime on date would claim, return 0 if
+//the range is malformed or outside the testing period
+int queryRange(char *date, char *startTime, char *endTime, int *first, int *last) {
+    if (validate_date(date) || validate_time(startTime) || validate_time(endTime)) return 0;
+    int start = atoi(startTime) * 60 + atoi(startTime + 3);
+    int end = atoi(endTime) * 60 + atoi(endTime + 3);
+    if (end <= start) return 0;
+
+    Booking range = {0};
+    strcpy(range.date, date);
+    strcpy(range.time, startTime);
+    range.duration = (end - start) / 60.0f;
+    int startDay, endDay, startSlot, endSlot;
+    if (!booking_slot_range(&range, &startDay, &endDay, &startSlot, &endSlot)) return 0;
+    *first = startDay * TIME_SLOT_PER_DAY + startSlot;
+    *last = endDay * TIME_SLOT_PER_DAY + endSlot;
+    return 1;
+}
 
-            insertToLinklist(&booking);
-        }
+void printAvailability(const char *date, const char *startTime, const char *endTime, const int freeUnits[RESOURCE_NUM]) {
+    printf("%s %s-%s ", date, startTime, endTime);
+    int r;
+    for (r = 0; r < resource_count; r++) printf(" %s %d/%d", resource_catalog[r].title, freeUnits[r], availability_capacity[r]);
+    printf("\n");
+}
 
+//queryAvailability -YYYY-MM-DD hh:mm hh:mm; or queryAvailability -file;
+//Free units are the fewest over the range, so a booking of exactly that
+//range would still be admitted on as many units.
+void queryAvailability(char *keyword[], int keywordLength) {
+    if (keywordLength == 2) {
+        queryAvailabilityFile(stripArgument(keyword[1]));
+        return;
+    }
+    if (keywordLength != 4) {
+        printf("-> Please check your command again.\n");
+        return;
+    }
+    char *date = stripArgument(keyword[1]);
+    char *endTime = stripArgument(keyword[3]);
+    int first, last, freeUnits[RESOURCE_NUM];
+    if (!queryRange(date, keyword[2], endTime, &first, &last)) {
+        printf("-> Invalid request: range not recognized or not in testing period.\n");
+        return;
+    }
+    if (!refreshAvailability()) {
+        printf("-> Memory allocation failed.\n");
+        return;
+    }
+    availability_query(first, last, freeUnits);
+    printAvailability(date, keyword[2], endTime, freeUnits);
+}
 
-    } else if (strcmp(keyword[0], "bookEssentials") == 0) {
+//One query per line: YYYY-MM-DD hh:mm hh:mm. Queries are answered first and
+//printed afterwards, so the reported time covers the lookups only.
+void queryAvailabilityFile(char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        printf("-> Could not open file: %s\n", filename);
+        return;
+    }
+    if (!refreshAvailability()) {
+        printf("-> Memory allocation failed.\n");
+        fclose(file);
+        return;
+    }
 
-        if (checkForBookEssentials(keyword, keywordLength)) {
-            booking.priority = 1;
+    AvailabilityQuery *queries = NULL;
+    int count = 0, allocated = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *date = strtok(line, " \t\r\n;");
+        char *startTime = strtok(NULL, " \t\r\n;");
+        char *endTime = strtok(NULL, " \t\r\n;");
+        if (date == NULL || date[0] == '#') continue;
+        if (count == allocated) {
+            allocated = allocated ? allocated * 2 : 256;
+            AvailabilityQuery *grown = (AvailabilityQuery*)realloc(queries, allocated * sizeof(AvailabilityQuery));
+            if (!grown) {
+                printf("-> Memory allocation failed.\n");
+                free(queries);
+                fclose(file);
+                return;
+            }
+            queries = grown;
+        }
+        AvailabilityQuery *query = &queries[count++];
+        snprintf(query->date, sizeof(query->date), "%s", date);
+        snprintf(query->startTime, sizeof(query->startTime), "%s", startTime ? startTime : "");
+        snprintf(query->endTime, sizeof(query->endTime), "%s", endTime ? endTime : "");
+        query->valid = startTime && endTime && queryRange(date, startTime, endTime, &query->first, &query->last);
+    }
+    fclose(file);
 
-            strncpy(booking.member, keyword[1], sizeof(booking.member) - 1);
-            booking.member[sizeof(booking.member) - 1] = '\0';
+    struct timespec start, end;
+    int i;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; i++) {
+        if (queries[i].valid) availability_query(queries[i].first, queries[i].last, queries[i].freeUnits);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
 
-            strcpy(booking.date, keyword[2]);
-            strcpy(booking.time, keyword[3]);
-            booking.duration = atoi(keyword[4]);
+    for (i = 0; i < count; i++) {
+        if (queries[i].valid) printAvailability(queries[i].date, queries[i].startTime, queries[i].endTime, queries[i].freeUnits);
+        else printf("%s %s-%s  invalid range\n", queries[i].date, queries[i].startTime, queries[i].endTime);
+    }
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("-> %d quer%s answered in %.1f us (%.0f ns each).\n", count, count == 1 ? "y" : "ies", ns / 1e3, count ? ns / count : 0);
+    free(queries);
+}
 
-            insertEssentials(&booking,keywordLength-5,keyword,0);
+//List the bookings waiting for capacity, earliest first
+void printWaitlist() {
+    int *ids;
+    int n = waitlist_candidates((1u << RESOURCE_NUM) - 1, 0, TESTING_DAY - 1, &ids);
+    if (n < 0) {
+        printf("-> Memory allocation failed.\n");
+        return;
+    }
+    printf("*** Waitlist: %d booking(s) ***\n", n);
+    int i;
+    for (i = 0; i < n; i++) {
+        BookingEntry *entry = booking_index_get(ids[i]);
+        if (!entry) continue;
+        const Booking *b = &entry->node->booking;
+        printf("%-8d%-15s%-15s%-8s%g\n", ids[i], member_name(b->member_id), b->date, b->time, b->duration);
+    }
+    free(ids);
+}
 
-            insertToLinklist(&booking);
+//print [-member_X] [-from YYYY-MM-DD] [-to YYYY-MM-DD] [-resource name];
+//Bookings of the current site matching every filter given, in store order.
+//Each filter may be given once; a second member or a repeated option is rejected.
+//Only the index lists of the member (or resource) on the days in range are
+//read, so the cost follows the bookings listed, not the size of the store.
+int printFiltered(char *keyword[], int keywordLength) {
+    int memberId = -1, resource = -1;
+    char *from = NULL, *to = NULL;
+    int i;
+    for (i = 1; i < keywordLength; i++) {
+        char *argument = stripArgument(keyword[i]);
+        if ((strcmp(argument, "from") == 0 || strcmp(argument, "to") == 0 || strcmp(argument, "resource") == 0) && i + 1 < keywordLength) {
+            char *value = stripArgument(keyword[++i]);
+            if (strcmp(argument, "resource") == 0) {
+                if (resource >= 0) return 0;
+                resource = catalog_find(value);
+                if (resource < 0) return 0;
+            } else {
+                if (validate_date(value)) return 0;
+                if (strcmp(argument, "from") == 0) {
+                    if (from) return 0;
+                    from = value;
+                } else {
+                    if (to) return 0;
+                    to = value;
+                }
+            }
+        } else if (memberId >= 0 || (memberId = member_lookup(argument)) < 0) {
+            return 0;
+        }
+    }
 
+    //Days of the testing period in range, plus the outside day if the range leaves the period
+    int firstDay = from ? date_to_day_index(from) : -1;
+    int lastDay = to ? date_to_day_index(to) : TESTING_DAY;
+    int outside = firstDay < 0 || lastDay >= TESTING_DAY;
+    if (firstDay < 0) firstDay = 0;
+    if (lastDay >= TESTING_DAY) lastDay = TESTING_DAY - 1;
+
+    int total = 0, day;
+    for (day = 0; day < INDEX_DAYS; day++) {
+        if ((day == INDEX_OTHER_DAY && !outside) || (day != INDEX_OTHER_DAY && (day < firstDay || day > lastDay))) continue;
+        IdList *list = booking_index_list(memberId, resource, day);
+        if (list) total += booking_index_compact(list, day);
+    }
+    int *ids = (int*)malloc((total + 1) * sizeof(int));
+    if (!ids) {
+        printf("-> Memory allocation failed.\n");
+        return 1;
+    }
+    int n = 0;
+    for (day = 0; day < INDEX_DAYS; day++) {
+        if ((day == INDEX_OTHER_DAY && !outside) || (day != INDEX_OTHER_DAY && (day < firstDay || day > lastDay))) continue;
+        IdList *list = booking_index_list(memberId, resource, day);
+        if (!list) continue;
+        for (i = 0; i < list->count; i++) {
+            const Booking *b = &booking_index_get(list->ids[i])->node->booking;
+            if (b->site_id != current_site) continue;
+            if (memberId >= 0 && resource >= 0 && !(resource_mask(b) >> resource & 1)) continue;
+            if ((from && strcmp(b->date, from) < 0) || (to && strcmp(b->date, to) > 0)) continue;
+            ids[n++] = list->ids[i];
         }
+    }
+    //Ids grow in store order; a booking moved back to an earlier day is filed twice
+    qsort(ids, n, sizeof(int), compare_booking_id);
+    int unique = 0;
+    for (i = 0; i < n; i++) {
+        if (unique == 0 || ids[unique - 1] != ids[i]) ids[unique++] = ids[i];
+    }
 
-    } else if (strcmp(keyword[0], "addEvent") == 0) {
+    fflush(stdout);
+    AioWriter out;
+    aio_writer_open(&out, STDOUT_FILENO);
+    aio_writer_printf(&out, "*** Bookings");
+    if (memberId >= 0) aio_writer_printf(&out, " of %s", member_name(memberId));
+    if (resource >= 0) aio_writer_printf(&out, " using %s", resource_catalog[resource].title);
+    if (from) aio_writer_printf(&out, " from %s", from);
+    if (to) aio_writer_printf(&out, " to %s", to);
+    aio_writer_printf(&out, ": %d ***\n", unique);
+    aio_writer_printf(&out, "%-8s%-12s%-15s%-8s%-8s%-15s%-12s%-10s\n", "Id", "Member", "Date", "Start", "End", "Type", "Space", "Device");
+    for (i = 0; i < unique; i++) {
+        BookingEntry *entry = booking_index_get(ids[i]);
+        //Stored bookings only hold units while online admission runs
+        Booking b = entry->node->booking;
+        memcpy(b.units, entry->units.unit, sizeof(b.units));
+        b.scattered = slot_units_scattered(&entry->units);
+        aio_writer_printf(&out, "%-8d%-12s", b.booking_id, member_name(b.member_id));
+        printBookingRow(&out, &b, 20);
+    }
+    aio_writer_close(&out);
+    free(ids);
+    return 1;
+}
 
-        if (checkForAddEvent(keyword, keywordLength)) {
-            booking.parking_space = 1;
-            booking.priority = 4;
+//Replace date, time and duration of a stored booking in place, keeping its
+//position in the store. Under online admission the old units are released
+//first and the booking keeps them if the new range does not fit.
+//Return a COMMAND_* result, COMMAND_INVALID if there is no such booking.
+int updateBooking(const Booking *updated) {
+    BookingEntry *entry = booking_index_get(updated->booking_id);
+    if (!entry) return COMMAND_INVALID;
+    Booking *booking = &entry->node->booking;
+    slot_occupancy_valid = 0;
+    availability_invalidate();
+    if (!onlineAdmission || booking->site_id != current_site) {
+        booking_index_refile(booking, updated);
+        *booking = *updated;
+        return COMMAND_STORED;
+    }
 
-            strncpy(booking.member, keyword[1], sizeof(booking.member) - 1);
-            booking.member[sizeof(booking.member) - 1] = '\0';
+    SlotUnits units;
+    release_booking(&liveIndex, booking, &entry->units);
+    switch (admit_booking(&liveIndex, updated, &units)) {
+        case ADMIT_ACCEPTED:
+            booking_index_refile(booking, updated);
+            *booking = *updated;
+            slot_units_free(&entry->units);
+            entry->units = units;
+            waitlist_remove(updated->booking_id);
+            return COMMAND_ACCEPTED;
+        case ADMIT_REJECTED:
+            retake_booking(&liveIndex, booking, &entry->units);
+            return COMMAND_REJECTED;
+        default:
+            retake_booking(&liveIndex, booking, &entry->units);
+            return COMMAND_OUT_OF_RANGE;
+    }
+}
 
-            strcpy(booking.date, keyword[2]);
-            strcpy(booking.time, keyword[3]);
-            booking.duration = atoi(keyword[4]);
+//cancelBooking -id;
+int cancelCommand(char *keyword[], int keywordLength) {
+    if (keywordLength != 2) return 0;
+    int bookingId = atoi(stripArgument(keyword[1]));
+    BookingEntry *entry = booking_index_get(bookingId);
+    if (!entry) {
+        printf("-> Booking not found: %d\n", bookingId);
+        return 1;
+    }
+    wal_log(WAL_CANCEL, &entry->node->booking);
+    printf("-> Booking %d cancelled.\n", bookingId);
+    removeBooking(bookingId);
+    return 1;
+}
 
-            insertEssentials(&booking,keywordLength-5,keyword,1);
+//modifyBooking -id YYYY-MM-DD hh:mm n.n;
+int modifyCommand(char *keyword[], int keywordLength) {
+    if (keywordLength != 5) return 0;
+    int bookingId = atoi(stripArgument(keyword[1]));
+    BookingEntry *entry = booking_index_get(bookingId);
+    if (!entry) {
+        printf("-> Booking not found: %d\n", bookingId);
+        return 1;
+    }
+    int errors = validate_fields(keyword[2], keyword[3], keyword[4]);
+    if (errors) {
+        printValidationError(errors);
+        return 1;
+    }
 
-            insertToLinklist(&booking);
-        }
+    Booking old = entry->node->booking;
+    //Only which resources held units matters once the old range is released
+    SlotUnits oldUnits;
+    slot_units_init(&oldUnits);
+    memcpy(oldUnits.unit, entry->units.unit, sizeof(oldUnits.unit));
+    Booking updated = old;
+    strcpy(updated.date, keyword[2]);
+    strcpy(updated.time, keyword[3]);
+    updated.duration = atof(keyword[4]);
+    int result = updateBooking(&updated);
+    if (result == COMMAND_STORED || result == COMMAND_ACCEPTED) wal_log(WAL_MODIFY, &updated);
+    printCommandResult(result);
+    if (result == COMMAND_STORED || result == COMMAND_ACCEPTED) printf("-> Booking %d modified.\n", bookingId);
+    else printf("-> Booking %d unchanged.\n", bookingId);
+    //The old range is free now, unless the new one took it back
+    if (result == COMMAND_ACCEPTED) promoteReleased(&old, &oldUnits);
+    return 1;
+}
 
+//Hand every node of a restored list to the store of its site
+void restoreBookings(Node *list) {
+    while (list != NULL) {
+        Node *next = list->next;
+        appendNode(list);
+        list = next;
     }
+}
 
+//Save the stores of every site to filename, return the bookings saved or -1.
+//The default snapshot is the recovery checkpoint, so the log restarts from it.
+int saveBookings(const char *filename) {
+    syncCurrentSite();
+    Node **lists = (Node**)malloc(site_count * sizeof(Node*));
+    if (!lists) return -1;
+    int i;
+    for (i = 0; i < site_count; i++) lists[i] = sites[i].head;
+    int saved = save_snapshot(filename, lists, site_count, slot_occupancy_valid);
+    free(lists);
+    if (saved >= 0 && strcmp(filename, SNAPSHOT_FILE) == 0) wal_truncate();
+    return saved;
 }
 
-void readBatchFile(char *filename) {
-    // 處理開頭 '-' 和結尾 ';'
-    char cleaned[100];
-    strncpy(cleaned, filename, sizeof(cleaned));
-    cleaned[sizeof(cleaned) - 1] = '\0';
+//Write head/tail back to the site table so every store can be walked from sites[]
+void syncCurrentSite() {
+    sites[current_site].head = head;
+    sites[current_site].tail = tail;
+}
 
-    int len = strlen(cleaned);
-    if (cleaned[len - 1] == ';') cleaned[len - 1] = '\0';
-    if (cleaned[0] == '-') memmove(cleaned, cleaned + 1, strlen(cleaned));
+//Make siteId the site that commands book into and schedule
+void selectSite(int siteId) {
+    syncCurrentSite();
+    current_site = siteId;
+    head = sites[siteId].head;
+    tail = sites[siteId].tail;
+    memcpy(resource_capacity, sites[siteId].capacity, sizeof(resource_capacity));
+    //The last schedule belongs to the previous site
+    slot_occupancy_valid = 0;
+    availability_invalidate();
+    if (onlineAdmission && !setOnlineAdmission(1)) printf("-> Memory allocation failed while building slot index.\n");
+}
 
-    FILE *file = fopen(cleaned, "r");
-    if (!file) {
-        printf("-> Could not open file: %s\n", cleaned);
-        return;
+//addSite -name [capacity of every resource in catalog order];
+int addSite(char *keyword[], int keywordLength) {
+    int capacity[RESOURCE_NUM];
+    catalog_capacities(capacity);
+    int i;
+    for (i = 2; i < keywordLength && i - 2 < resource_count; i++) {
+        capacity[i - 2] = atoi(stripArgument(keyword[i]));
+        if (capacity[i - 2] < 0) return 0;
     }
+    char *name = stripArgument(keyword[1]);
+    int siteId = site_register(name, capacity);
+    if (siteId < 0) return 0;
+    if (siteId == current_site && (!onlineAdmission || !growLiveCapacity(capacity))) selectSite(siteId);
+    if (!save_site_file(SITE_FILE)) printf("-> Could not write file: %s\n", SITE_FILE);
+    printf("-> Site %s registered, %d site(s) in total.\n", name, site_count);
+    return 1;
+}
 
-    char *buffer = malloc(100000);
-    if (!buffer) {
-        printf("-> Memory allocation failed.\n");
-        fclose(file);
+//Schedule every site with FCFS in parallel and print one line per site
+void printSiteSummary() {
+    syncCurrentSite();
+    SiteResult *results = (SiteResult*)calloc(site_count, sizeof(SiteResult));
+    if (!results) {
+        printf("-> Memory allocation failed while scheduling sites.\n");
         return;
     }
+    int workers = schedule_sites(results);
 
-    size_t length = fread(buffer, 1, 99999, file);
-    buffer[length] = '\0';
-    fclose(file);
+    printf("*** Parking Booking Manager - Site Summary / FCFS ***\n\n");
+    printSiteResults(results);
+    printf("\n-> %d site(s) scheduled by %d worker(s).\n", site_count, workers);
+    free(results);
+}
 
-    // Sentence segmentation (remove spaces but retain the last word)）
-    char *saveptr1;
-    char *sentence = strtok_r(buffer, ";", &saveptr1);
-    while (sentence != NULL) {
-        while (*sentence == ' ' || *sentence == '\n' || *sentence == '\r') sentence++;  // remove leading whitespace and newline characters
+void printSiteResults(SiteResult *results) {
+    printf("%-20s%-10s%-10s%-10s%-10s\n", "Site", "Bookings", "Assigned", "Rejected", "Invalid");
+    printf("====================================================================================\n");
+    int i;
+    for (i = 0; i < site_count; i++) {
+        if (results[i].failed) {
+            printf("%-20s%s\n", sites[i].name, "memory allocation failed");
+            continue;
+        }
+        printf("%-20s%-10d%-10d%-10d%-10d\n", sites[i].name, results[i].booking_num,
+               results[i].accepted_num, results[i].rejected_num, results[i].invalid_num);
+    }
+}
 
-        // add ';' in end
-        char fullSentence[256];
-        snprintf(fullSentence, sizeof(fullSentence), "%s;", sentence);
+//shardBookings -site|-date [-workers];
+//Schedule the bookings of every site with FCFS in worker processes, then merge
+//the decisions in booking order and print the current site's accepted and
+//rejected bookings followed by the per-site summary
+void shardBookings(char *mode, int workers) {
+    int shardMode;
+    if (strcmp(mode, "site") == 0) shardMode = SHARD_BY_SITE;
+    else if (strcmp(mode, "date") == 0) shardMode = SHARD_BY_DATE;
+    else {
+        printf("-> Please check your command again.\n");
+        return;
+    }
 
-        // divide the command
-        char *keyword[10];
-        int keywordLength = 0;
+    syncCurrentSite();
+    int n = 0, i;
+    Node *current;
+    for (i = 0; i < site_count; i++) {
+        for (current = sites[i].head; current != NULL; current = current->next) n++;
+    }
+    Booking *bookings = (Booking*)malloc((n + 1) * sizeof(Booking));
+    unsigned char *decision = (unsigned char*)malloc(n + 1);
+    SiteResult *results = (SiteResult*)calloc(site_count, sizeof(SiteResult));
+    if (!bookings || !decision || !results) {
+        printf("-> Memory allocation failed while scheduling sites.\n");
+        free(bookings); free(decision); free(results);
+        return;
+    }
+    n = 0;
+    for (i = 0; i < site_count; i++) {
+        for (current = sites[i].head; current != NULL; current = current->next) bookings[n++] = current->booking;
+    }
 
-        char *saveptr2;
-        char *word = strtok_r(fullSentence, " ", &saveptr2);
-        while (word != NULL && keywordLength < 10) {
-            keyword[keywordLength++] = word;
-            word = strtok_r(NULL, " ", &saveptr2);
-        }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int ok = shard_schedule(bookings, n, shardMode, workers, decision);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (!ok) {
+        printf("-> A scheduling worker failed, no result.\n");
+        free(bookings); free(decision); free(results);
+        return;
+    }
 
-        if (keywordLength > 0) {
-            executeCommand(keyword, keywordLength);
+    //Merge in booking order, so the result does not depend on the shard layout
+    Node *accepted = NULL, *acceptedTail = NULL, *rejected = NULL, *rejectedTail = NULL;
+    for (i = 0; i < n; i++) {
+        SiteResult *result = &results[bookings[i].site_id];
+        result->booking_num++;
+        if (decision[i] == ADMIT_ACCEPTED) result->accepted_num++;
+        else if (decision[i] == ADMIT_REJECTED) result->rejected_num++;
+        else result->invalid_num++;
+        if (bookings[i].site_id != current_site || decision[i] == ADMIT_OUT_OF_RANGE) continue;
+
+        Node *node = create_node(bookings[i]);
+        if (decision[i] == ADMIT_ACCEPTED) {
+            if (accepted == NULL) accepted = node;
+            else acceptedTail->next = node;
+            acceptedTail = node;
+        } else {
+            if (rejected == NULL) rejected = node;
+            else rejectedTail->next = node;
+            rejectedTail = node;
         }
-
-        sentence = strtok_r(NULL, ";", &saveptr1);
     }
+    printFormattedAcceptedBookings(accepted, "FCFS", 1);
+    printFormattedAcceptedBookings(rejected, "FCFS", 0);
+    free_list(accepted);
+    free_list(rejected);
 
-    free(buffer);
+    printf("*** Parking Booking Manager - Sharded Summary / FCFS ***\n\n");
+    printSiteResults(results);
+    double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("\n-> %d booking(s) of %d site(s) scheduled by %d worker process(es) in %.2f ms.\n", n, site_count, workers, ms);
+    free(bookings);
+    free(decision);
+    free(results);
 }
 
-//addParking -aaa YYYY-MM-DD hh:mm n.n bbb ccc;
-int checkForaddParking(char *keyword[],int keywordLength) {
-    if (keywordLength < 5) {printf("-> Invalid request: please check whether the complete command is entered.\n"); return 0;}
 
-    if (!commonInspectItem(keyword,keywordLength) ) return 0;
+//Validate and store one booking command. fieldErrors are the date, time and
+//duration errors found by validate_fields_batch, or -1 to check them here.
+int executeCommand(char *keyword[],int keywordLength, int fieldErrors) {
+    Booking booking;
+    int errors = parseCommand(keyword, keywordLength, fieldErrors, &booking);
+    if (errors) {
+        printValidationError(errors);
+        return COMMAND_INVALID;
+    }
+    return storeBooking(&booking);
+}
 
+//Validate one booking command and build its booking without touching the
+//store, so batch chunks can be parsed on several threads. Return its INVALID_* bits.
+int parseCommand(char *keyword[], int keywordLength, int fieldErrors, Booking *booking) {
+    int errors = validateCommand(keyword, keywordLength, fieldErrors);
+    if (errors) return errors;
 
-    if (keywordLength < 6) return 1;
-    if (keywordLength >=8) { printf("-> Booking quantity is incorrect.\n"); return 0; }
+    memset(booking, 0, sizeof(Booking));
+    memset(booking->units, -1, sizeof(booking->units));     //Assigned by scheduling
+    booking->member_id = member_lookup(keyword[1] + 1);
+    strcpy(booking->date, keyword[2]);
+    strcpy(booking->time, keyword[3]);
+    booking->duration = atof(keyword[4]);
 
-    if ( !checkForEssentials(keyword,keywordLength)){printf("-> Invalid request: essentials not recognized.\n"); return 0;}
+    //Essentials are compared without the ';' closing the command
+    if (keywordLength > 5) stripArgument(keyword[keywordLength - 1]);
 
-    return 1;
+    if (strcmp(keyword[0], "addParking") == 0) {
+        booking_request(booking, SPACE, 1);
+        booking->priority = 2;
+        insertEssentials(booking,keywordLength-5,keyword,1);
+    } else if (strcmp(keyword[0], "addReservation") == 0) {
+        booking_request(booking, SPACE, 1);
+        booking->priority = 3;
+        insertEssentials(booking,keywordLength-5,keyword,1);
+    } else if (strcmp(keyword[0], "bookEssentials") == 0) {
+        booking->priority = 1;
+        insertEssentials(booking,keywordLength-5,keyword,0);
+    } else {
+        booking->priority = 4;
+        insertQuantities(booking,keywordLength-5,keyword);
+    }
+    return 0;
 }
 
-//addReservation -aaa YYYY-MM-DD hh:mm n.n bbb ccc;
-int checkForAddReservation(char *keyword[],int keywordLength) {
-    if (keywordLength != 7) {printf("-> Invalid request: please check whether the complete command is entered.\n"); return 0;}
-
-    if (!commonInspectItem(keyword,keywordLength) ) return 0;
-
-    if ( !checkForEssentials(keyword,keywordLength)){printf("-> Invalid request: essentials not recognized.\n"); return 0;}
+//Append a validated booking to the store and the log, and admit it when online
+int storeBooking(Booking *booking) {
+    booking->site_id = current_site;
+    booking->booking_id = booking_next_id++;
+    insertToLinklist(booking);
+    wal_append(booking);
+    if (!onlineAdmission) return COMMAND_STORED;
+
+    BookingEntry *entry = booking_index_get(booking->booking_id);
+    int admitted = admit_booking(&liveIndex, booking, entry ? &entry->units : NULL);
+    if (admitted == ADMIT_REJECTED) waitlist_add(booking);
+    switch (admitted) {
+        case ADMIT_ACCEPTED: return COMMAND_ACCEPTED;
+        case ADMIT_REJECTED: return COMMAND_REJECTED;
+        default: return COMMAND_OUT_OF_RANGE;
+    }
+}
 
+//Switch online admission on or off. Turning it on replays the stored bookings
+//so the live index matches what the FCFS policy of run_schedule would decide.
+int setOnlineAdmission(int enable) {
+    if (onlineAdmission) {
+        slot_index_free(&liveIndex);
+        booking_index_drop_units();
+    }
+    onlineAdmission = 0;
+    waitlist_clear();
+    availability_invalidate();
+    if (!enable) return 1;
+
+    if (!slot_index_init(&liveIndex, resource_capacity)) return 0;
+    Node *current;
+    for (current = head; current != NULL; current = current->next) {
+        BookingEntry *entry = booking_index_get(current->booking.booking_id);
+        if (admit_booking(&liveIndex, &current->booking, entry ? &entry->units : NULL) == ADMIT_REJECTED) waitlist_add(&current->booking);
+    }
+    onlineAdmission = 1;
     return 1;
 }
 
-//addEvent -aaa YYYY-MM-DD hh:mm n.n bbb ccc ddd;
-int checkForAddEvent(char *keyword[],int keywordLength) {
+//Report the admission decision of an online booking
+void printCommandResult(int result) {
+    if (result == COMMAND_ACCEPTED) printf("-> ACCEPTED\n");
+    else if (result == COMMAND_REJECTED) printf("-> REJECTED\n");
+    else if (result == COMMAND_OUT_OF_RANGE) printf("-> REJECTED: not in testing period\n");
+}
 
-    if (keywordLength <5 || keywordLength >8) {printf("-> Invalid request: please check whether the complete command is entered.\n"); return 0;}
+void readBatchFile(char *filename, int strict) {
+    // 處理開頭 '-' 和結尾 ';'
+    char cleaned[100];
+    strncpy(cleaned, filename, sizeof(cleaned));
+    cleaned[sizeof(cleaned) - 1] = '\0';
 
-    if (!commonInspectItem(keyword,keywordLength) ) return 0;
+    int len = strlen(cleaned);
+    if (cleaned[len - 1] == ';') cleaned[len - 1] = '\0';
+    if (cleaned[0] == '-') memmove(cleaned, cleaned + 1, strlen(cleaned));
 
-    if (keywordLength == 5) return 1;
+    int fd = open(cleaned, O_RDONLY);
+    if (fd < 0) {
+        printf("-> Could not open file: %s\n", cleaned);
+        return;
+    }
 
-    if ( !checkForEssentials(keyword,keywordLength)){printf("-> Invalid request: essentials not recognized.\n"); return 0;}
+    //Strict batches are stored only if every command is valid
+    int firstInvalid = 0;
+    int invalid = strict ? runBatch(fd, 0, &firstInvalid) : 0;
+    if (invalid > 0) {
+        printf("-> Batch rejected: %d invalid command(s), first is command %d.\n", invalid, firstInvalid);
+    } else if (invalid == 0) {
+        invalid = runBatch(fd, 1, &firstInvalid);
+    }
+    if (invalid == BATCH_NO_MEMORY) printf("-> Memory allocation failed.\n");
+    else if (invalid == BATCH_READ_FAILED) printf("-> Could not read file: %s\n", cleaned);
 
-    return 1;
+    close(fd);
 }
 
-//bookEssentials –member_C 2025-05-011 13:00 4.0 battery;
-int checkForBookEssentials(char *keyword[],int keywordLength) {
-
-    if (keywordLength != 6) {printf("-> Invalid request: please check whether the complete command is entered.\n"); return 0;}
+//Split the next commands before limit at ';' into a block, return the number of commands
+int fillBatchBlock(BatchBlock *block, const char **cursor, const char *limit) {
+    const char *p = *cursor;
+    block->count = 0;
+    while (block->count < BATCH_BLOCK_LINES) {
+        // Sentence segmentation (remove spaces but retain the last word)
+        while (p < limit && *p == ';') p++;
+        if (p >= limit) break;
+        const char *end = memchr(p, ';', limit - p);
+        if (end == NULL) end = limit;
+        const char *sentence = p;
+        p = end < limit ? end + 1 : end;
+        while (sentence < end && (*sentence == ' ' || *sentence == '\n' || *sentence == '\r')) sentence++;  // remove leading whitespace and newline characters
+
+        int sentenceLength = (int)(end - sentence);
+        if (sentenceLength == 0) continue;   //Blank between commands, nothing to run
 
-    if (!commonInspectItem(keyword,keywordLength) ) return 0;
-
-    if ( !checkForEssentials(keyword,keywordLength)){printf("-> Invalid request: essentials not recognized.\n"); return 0;}
+        // add ';' in end
+        int i = block->count;
+        char *fullSentence = block->text[i];
+        snprintf(fullSentence, BATCH_SENTENCE_SIZE, "%.*s;", sentenceLength, sentence);
 
+        // divide the command
+        char **keyword = block->keyword[i];
+        int keywordLength = 0;
+        char *saveptr;
+        char *word = strtok_r(fullSentence, " ", &saveptr);
+        while (word != NULL && keywordLength < 10) {
+            keyword[keywordLength++] = word;
+            word = strtok_r(NULL, " ", &saveptr);
+        }
+        if (keywordLength == 0) continue;
 
-    return 1;
+        block->keywordLength[i] = keywordLength;
+        block->dates[i] = keywordLength >= 5 ? keyword[2] : NULL;
+        block->times[i] = keywordLength >= 5 ? keyword[3] : NULL;
+        block->hours[i] = keywordLength >= 5 ? keyword[4] : NULL;
+        block->count++;
+    }
+    *cursor = p;
+    return block->count;
 }
 
+//First command boundary at or after p: just past the next ';', or limit
+const char* batchBoundary(const char *p, const char *limit) {
+    if (p >= limit) return limit;
+    const char *end = memchr(p, ';', limit - p);
+    return end ? end + 1 : limit;
+}
 
-void insertEssentials(Booking *booking, int numOfEssentials, char *keyword[],int isPair) {
-    booking->battery = 0;
-    booking->cable = 0;
-    booking->locker = 0;
-    booking->umbrella = 0;
-    booking->valet = 0;
-    booking->inflation = 0;
-
-    if (!isPair) {
-        char *essential = keyword[5];
-        if (strcmp(essential, "battery") == 0 ) {
-            booking->battery = 1;
-        }else if (strcmp(essential, "cable")  == 0) {
-            booking->cable = 1;
-        }else if (strcmp(essential, "umbrella") == 0) {
-            booking->umbrella = 1;
-        }else if (strcmp(essential, "locker") == 0 ) {
-            booking->locker = 1;
-        } else if ( strcmp(essential, "InflationService") == 0) {
-            booking->inflation = 1;
-        }else if (strcmp(essential, "valetPark") == 0 ) {
-            booking->valet = 1;
+//Parse and validate whole chunks until none is left, tokenizing into *block,
+//which is allocated on first use and kept for the next window. Chunks only
+//read the file and the member table, so any number of threads can run this.
+void parseBatchChunks(BatchParseJob *job, BatchBlock **blockSlot) {
+    while (1) {
+        int c = atomic_fetch_add(&job->next_chunk, 1);
+        if (c >= job->chunk_num) break;
+        BatchChunk *chunk = &job->chunks[c];
+        if (!*blockSlot) *blockSlot = (BatchBlock*)malloc(sizeof(BatchBlock));
+        BatchBlock *block = *blockSlot;
+        if (!block) {
+            chunk->failed = 1;
+            continue;
         }
 
-        return;
+        const char *cursor = chunk->start;
+        while (!chunk->failed && fillBatchBlock(block, &cursor, chunk->end) > 0) {
+            validate_fields_batch(block->dates, block->times, block->hours, block->count, block->errors);
+            if (chunk->count + block->count > chunk->allocated) {
+                int allocated = chunk->allocated ? chunk->allocated * 2 : BATCH_BLOCK_LINES;
+                ParsedCommand *grown = (ParsedCommand*)realloc(chunk->commands, allocated * sizeof(ParsedCommand));
+                if (!grown) {
+                    chunk->failed = 1;
+                    break;
+                }
+                chunk->commands = grown;
+                chunk->allocated = allocated;
+            }
+            int i;
+            for (i = 0; i < block->count; i++) {
+                ParsedCommand *command = &chunk->commands[chunk->count++];
+                if (job->build) command->errors = parseCommand(block->keyword[i], block->keywordLength[i], block->errors[i], &command->booking);
+                else command->errors = validateCommand(block->keyword[i], block->keywordLength[i], block->errors[i]);
+            }
+        }
     }
+}
 
-    int i;
-    for (i = 0; i < numOfEssentials; i++) {
-        char *essential = keyword[5 + i]; // essentials start from keyword[5]
+void batchPoolInit(BatchPool *pool) {
+    memset(pool, 0, sizeof(BatchPool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->posted, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+}
 
-        if (strcmp(essential, "battery") == 0 || strcmp(essential, "cable")  == 0) {
-            booking->battery = 1;
-            booking->cable = 1;
-        } else if (strcmp(essential, "locker") == 0 || strcmp(essential, "umbrella") == 0) {
-            booking->locker = 1;
-            booking->umbrella = 1;
-        } else if (strcmp(essential, "valetPark") == 0 || strcmp(essential, "InflationService") == 0) {
-            booking->valet = 1;
-            booking->inflation = 1;
-        }
+//Wait for a window, help parse it, and sleep again until the pool stops. A
+//worker that wakes after its window is done finds job NULL and goes back to sleep.
+void* batchPoolWorker(void *arg) {
+    BatchWorker *worker = (BatchWorker*)arg;
+    BatchPool *pool = worker->pool;
+    int seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->stop && (pool->generation == seen || pool->job == NULL)) pthread_cond_wait(&pool->posted, &pool->lock);
+        if (pool->stop) break;
+        seen = pool->generation;
+        BatchParseJob *job = pool->job;
+        pool->active++;
+        pthread_mutex_unlock(&pool->lock);
+        parseBatchChunks(job, &pool->blocks[worker->index]);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->idle);
     }
+    pthread_mutex_unlock(&pool->lock);
+    free(worker);
+    return NULL;
 }
 
+//Parse the chunks of a window on up to threadNum threads, the caller included,
+//starting pool workers only when the window has chunks for more of them
+void parseBatchWindow(BatchPool *pool, BatchParseJob *job, int threadNum) {
+    atomic_init(&job->next_chunk, 0);
+    while (pool->thread_num < threadNum - 1) {
+        BatchWorker *worker = (BatchWorker*)malloc(sizeof(BatchWorker));
+        if (!worker) break;
+        worker->pool = pool;
+        worker->index = pool->thread_num;
+        if (pthread_create(&pool->threads[pool->thread_num], NULL, batchPoolWorker, worker) != 0) {
+            free(worker);
+            break;
+        }
+        pool->thread_num++;
+    }
 
-int commonInspectItem(char *keyword[],int keywordLength) {
-    if ( !checkForMemberName(keyword[1])){ printf("-> Invalid request: member name not recognized.\n");return 0; }
-    if ( !checkForDate(keyword[2])){  printf("-> Invalid request: date format not recognized (YYYY-MM-DD expected).\n");return 0; }
-    if ( !checkForTime(keyword[3])){ printf("-> Invalid request: time format not recognized (HH:MM expected).\n"); return 0; }
-    if ( !checkForHours(keyword[4])) { printf("-> Invalid request: booking hours format not recognized (n.n).\n"); return 0; }
-
-    return 1;
-}
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->posted);
+    pthread_mutex_unlock(&pool->lock);
 
-// check the name is match the rules
-int checkForMemberName(char *name) {
+    parseBatchChunks(job, &pool->blocks[BATCH_MAX_THREADS]);
 
-    memmove(name, name + 1, strlen(name));
+    //Every chunk is taken; the window is done once no worker still parses one
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) pthread_cond_wait(&pool->idle, &pool->lock);
+    pool->job = NULL;
+    pthread_mutex_unlock(&pool->lock);
+}
 
+void batchPoolStop(BatchPool *pool) {
     int i;
-    for (i = 0; i < 5; i++) {
-        if (strcmp(name, validMembers[i]) == 0) {
-
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->posted);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->thread_num; i++) pthread_join(pool->threads[i], NULL);
+    for (i = 0; i <= BATCH_MAX_THREADS; i++) free(pool->blocks[i]);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->posted);
+    pthread_cond_destroy(&pool->idle);
+}
 
-            return 1;
+//Parse one window of whole commands in chunks split at ';', several chunks
+//in parallel, then walk the chunks in file order so the store and FCFS see
+//the commands exactly as written. When execute is set, valid commands are
+//stored. commands and invalid carry over between windows; return 0 on failure.
+int runBatchWindow(BatchPool *pool, const char *window, const char *windowEnd, int execute, int *commands, int *invalid, int *firstInvalid) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int cpuNum = cpus < 1 ? 1 : (cpus > BATCH_MAX_THREADS ? BATCH_MAX_THREADS : (int)cpus);
+    BatchChunk chunks[BATCH_MAX_THREADS * BATCH_CHUNKS_PER_THREAD];
+    BatchParseJob job;
+    job.chunks = chunks;
+    job.build = execute;
+
+    size_t windowSize = windowEnd - window;
+    int chunkNum = cpuNum * BATCH_CHUNKS_PER_THREAD;
+    if ((size_t)chunkNum > windowSize / BATCH_MIN_CHUNK + 1) chunkNum = (int)(windowSize / BATCH_MIN_CHUNK + 1);
+
+    //Chunk boundaries start just past a ';', like any command
+    int c;
+    const char *start = window;
+    for (c = 0; c < chunkNum; c++) {
+        const char *end = c == chunkNum - 1 ? windowEnd : batchBoundary(window + windowSize * (c + 1) / chunkNum, windowEnd);
+        if (end < start) end = start;
+        memset(&chunks[c], 0, sizeof(BatchChunk));
+        chunks[c].start = start;
+        chunks[c].end = end;
+        start = end;
+    }
+    job.chunk_num = chunkNum;
+    parseBatchWindow(pool, &job, chunkNum < cpuNum ? chunkNum : cpuNum);
+
+    int failed = 0;
+    for (c = 0; c < chunkNum; c++) {
+        if (chunks[c].failed) failed = 1;
+        int i;
+        for (i = 0; i < chunks[c].count && !failed; i++) {
+            ParsedCommand *command = &chunks[c].commands[i];
+            (*commands)++;
+            if (command->errors) {
+                if (execute) printValidationError(command->errors);
+                else if ((*invalid)++ == 0) *firstInvalid = *commands;
+            } else if (execute) {
+                printCommandResult(storeBooking(&command->booking));
+            }
         }
+        free(chunks[c].commands);
     }
-
-    return 0;
+    return !failed;
 }
 
-int checkForDate(char *date) {
-    // verify the format YYYY-MM-DD
-    if (strlen(date) != 10 || date[4] != '-' || date[7] != '-') return 0;
+//Stream a batch file through runBatchWindow. The next window is read ahead
+//with aio_submit while the current one is parsed and stored, and one pool of
+//parse threads serves every window. Return the number of invalid commands,
+//BATCH_NO_MEMORY or BATCH_READ_FAILED.
+int runBatch(int fd, int execute, int *firstInvalid) {
+    //Each buffer keeps room in front for the unfinished command of the last window
+    char *buffers[2];
+    buffers[0] = (char*)malloc(BATCH_SENTENCE_SIZE + BATCH_WINDOW_SIZE);
+    buffers[1] = (char*)malloc(BATCH_SENTENCE_SIZE + BATCH_WINDOW_SIZE);
+    if (!buffers[0] || !buffers[1]) {
+        free(buffers[0]);
+        free(buffers[1]);
+        return BATCH_NO_MEMORY;
+    }
 
+    char carry[BATCH_SENTENCE_SIZE];
+    int carryLength = 0;
+    int discard = 0;        //Skip to the next ';', the carried command is already full
+    int invalid = 0, commands = 0, result = 0, current = 0, reading = 1;
+    off_t offset = 0;
+    AioRequest request;
+    BatchPool pool;
+    batchPoolInit(&pool);
+    *firstInvalid = 0;
+    aio_submit(&request, AIO_READ, fd, buffers[0] + BATCH_SENTENCE_SIZE, BATCH_WINDOW_SIZE, offset);
+    while (1) {
+        ssize_t length = aio_wait(&request);
+        reading = 0;
+        if (length < 0) {
+            result = BATCH_READ_FAILED;
+            break;
+        }
+        char *data = buffers[current] + BATCH_SENTENCE_SIZE;
+        char *end = data + length;
+        offset += length;
+        if (length > 0) {
+            aio_submit(&request, AIO_READ, fd, buffers[!current] + BATCH_SENTENCE_SIZE, BATCH_WINDOW_SIZE, offset);
+            reading = 1;
+        }
 
-    // extract and validate the month range
-    int month = (date[5] - '0') * 10 + (date[6] - '0');
-    if (month < 1 || month > 12) return 0;
+        char *start = data;
+        if (discard) {
+            char *semicolon = memchr(start, ';', end - start);
+            start = semicolon ? semicolon : end;
+            discard = semicolon == NULL;
+        }
+        start -= carryLength;
+        memcpy(start, carry, carryLength);
+
+        //Run up to the last ';', or to the end of the file
+        char *windowEnd = end;
+        if (length > 0) {
+            while (windowEnd > start && windowEnd[-1] != ';') windowEnd--;
+        }
+        if (windowEnd > start && !runBatchWindow(&pool, start, windowEnd, execute, &commands, &invalid, firstInvalid)) {
+            result = BATCH_NO_MEMORY;
+            break;
+        }
 
-    return 1; // valid date
+        //Only the first BATCH_SENTENCE_SIZE bytes of a command are ever parsed
+        while (windowEnd < end && (*windowEnd == ' ' || *windowEnd == '\n' || *windowEnd == '\r')) windowEnd++;
+        carryLength = end - windowEnd;
+        if (carryLength > BATCH_SENTENCE_SIZE) {
+            carryLength = BATCH_SENTENCE_SIZE;
+            discard = 1;
+        }
+        memcpy(carry, windowEnd, carryLength);
+        current = !current;
+        if (length == 0) break;
+    }
+    if (reading) aio_wait(&request);
+    batchPoolStop(&pool);
+    free(buffers[0]);
+    free(buffers[1]);
+    return result ? result : invalid;
 }
 
-int checkForTime(char *time) {
-    // verify the format HH:MM
-    if (strlen(time) != 5 || time[2] != ':') return 0;
+//Execute one booking command received by the server and return its reply
+const char* serveCommand(char *command) {
+    char *keyword[10];
+    int keywordLength = 0;
 
+    char *saveptr;
+    char *word = strtok_r(command, " ", &saveptr);
+    while (word != NULL && keywordLength < 10) {
+        keyword[keywordLength++] = word;
+        word = strtok_r(NULL, " ", &saveptr);
+    }
+    if (keywordLength == 0) return "INVALID";
+
+    if ((strcmp(keyword[0], "addParking") == 0) ||
+        (strcmp(keyword[0], "addReservation") == 0) ||
+        (strcmp(keyword[0], "bookEssentials") == 0) ||
+        (strcmp(keyword[0], "addEvent") == 0)) {
+        switch (executeCommand(keyword, keywordLength, -1)) {
+            case COMMAND_STORED: return "OK";
+            case COMMAND_ACCEPTED: return "ACCEPTED";
+            case COMMAND_REJECTED: return "REJECTED";
+            case COMMAND_OUT_OF_RANGE: return "OUT_OF_RANGE";
+            default: return "INVALID";
+        }
+    }
+    return "UNSUPPORTED";
+}
 
-    // extract and validate hour and minute
-    int hour = (time[0] - '0') * 10 + (time[1] - '0');
-    int minute = (time[3] - '0') * 10 + (time[4] - '0');
+//Remove the leading '-' and trailing ';' of a command argument in place
+char* stripArgument(char *argument) {
+    int len = strlen(argument);
+    if (len > 0 && argument[len - 1] == ';') argument[len - 1] = '\0';
+    if (argument[0] == '-') argument++;
+    return argument;
+}
 
-    if (hour < 0 || hour > 23) return 0;
-    if (minute < 0 || minute > 59) return 0;
+//Check a booking command without printing or modifying it, return its INVALID_* bits
+//addParking -aaa YYYY-MM-DD hh:mm n.n bbb ccc;
+//addReservation -aaa YYYY-MM-DD hh:mm n.n bbb ccc;
+//addEvent -aaa YYYY-MM-DD hh:mm n.n bbb[:k] ccc[:k] ddd[:k] space:k;
+//bookEssentials -aaa YYYY-MM-DD hh:mm n.n bbb;
+int validateCommand(char *keyword[], int keywordLength, int fieldErrors) {
+    int needEssentials;
+    if (strcmp(keyword[0], "addParking") == 0) {
+        if (keywordLength < 5) return INVALID_FIELD_COUNT;
+        needEssentials = keywordLength >= 6 && keywordLength < 8;
+    } else if (strcmp(keyword[0], "addReservation") == 0) {
+        if (keywordLength != 7) return INVALID_FIELD_COUNT;
+        needEssentials = 1;
+    } else if (strcmp(keyword[0], "addEvent") == 0) {
+        //Three essentials at most, plus the number of spaces as a fourth item
+        if (keywordLength < 5 || keywordLength > 9) return INVALID_FIELD_COUNT;
+        if (keywordLength == 9 && !hasSpaceQuantity(keyword, keywordLength)) return INVALID_FIELD_COUNT;
+        needEssentials = 0;
+    } else if (strcmp(keyword[0], "bookEssentials") == 0) {
+        if (keywordLength != 6) return INVALID_FIELD_COUNT;
+        needEssentials = 1;
+    } else {
+        return INVALID_UNKNOWN_COMMAND;
+    }
 
-    return 1; // valid time
+    int errors = 0;
+    //The member argument keeps its leading '-'
+    if (member_lookup(keyword[1] + 1) < 0) errors |= INVALID_MEMBER;
+    errors |= fieldErrors >= 0 ? fieldErrors : validate_fields(keyword[2], keyword[3], keyword[4]);
+    if (strcmp(keyword[0], "addParking") == 0 && keywordLength >= 8) errors |= INVALID_QUANTITY;
+    if (needEssentials && !checkForEssentials(keyword, keywordLength)) errors |= INVALID_ESSENTIALS;
+    if (strcmp(keyword[0], "addEvent") == 0 && keywordLength > 5) errors |= checkForQuantities(keyword, keywordLength);
+    return errors;
 }
 
-int checkForHours(char *hours) {
+//Print the message of the first check that failed
+void printValidationError(int errors) {
+    switch (first_validation_error(errors)) {
+        case INVALID_FIELD_COUNT: printf("-> Invalid request: please check whether the complete command is entered.\n"); break;
+        case INVALID_MEMBER: printf("-> Invalid request: member name not recognized.\n"); break;
+        case INVALID_DATE: printf("-> Invalid request: date format not recognized (YYYY-MM-DD expected).\n"); break;
+        case INVALID_TIME: printf("-> Invalid request: time format not recognized (HH:MM expected).\n"); break;
+        case INVALID_DURATION: printf("-> Invalid request: booking hours format not recognized (n.n).\n"); break;
+        case INVALID_QUANTITY: printf("-> Booking quantity is incorrect.\n"); break;
+        case INVALID_ESSENTIALS: printf("-> Invalid request: essentials not recognized.\n"); break;
+    }
+}
 
-    if (atof(hours) - atoi(hours) == 0) return 1;
-    else return 0;
 
+void insertEssentials(Booking *booking, int numOfEssentials, char *keyword[],int isPair) {
+    //bookEssentials books its one essential alone, the others also book the
+    //bundle the catalog gives each essential (battery with cable and so on)
+    if (!isPair && numOfEssentials > 1) numOfEssentials = 1;
+    int i;
+    for (i = 0; i < numOfEssentials; i++) {
+        char *essential = keyword[5 + i]; // essentials start from keyword[5]
+        int r = catalog_lookup(essential, strlen(essential));
+        if (r <= SPACE) continue;
+        booking_request(booking, r, 1);
+        if (!isPair) continue;
+        unsigned int bits;
+        for (bits = resource_catalog[r].bundle; bits; bits &= bits - 1) booking_request(booking, __builtin_ctz(bits), 1);
+    }
 }
 
+
 int checkForEssentials(char* keyword[],int keyLength) {
 
-    //check whether last char of last element is ';' symbol.
-    //then remove.
+    //check whether last char of last element is ';' symbol,
+    //which is left in place and skipped when comparing
     int len = strlen(keyword[keyLength - 1]);
     if (len == 0) return 0;
 
     if (keyword[keyLength - 1][len - 1] != ';') return 0;
 
-    keyword[keyLength - 1][len - 1] = '\0';  // remove ';'
-
 
 
     int isValid = 0;
-    int numValidEssentials = sizeof(validEssentials) / sizeof(validEssentials[0]);
 
     int i;
     for (i = 5; i < keyLength; i++) {
-        int found = 0;
-        int j;
-        for (j = 0; j < numValidEssentials; j++) {
-            if (strcmp(validEssentials[j], keyword[i]) == 0) {
-                found = 1;
-                break;
-            }
-        }
-        if (!found) return 0;
+        int wordLength = (i == keyLength - 1) ? len - 1 : (int)strlen(keyword[i]);
+        if (!knownResource(keyword[i], wordLength, 0)) return 0;
         else isValid = 1;
     }
 
     return isValid;
-}
\ No newline at end of file
+}
+
+//Items of addEvent: an essential or "space", each with an optional ":count"
+//of units. Return the INVALID_* bits of the items.
+int checkForQuantities(char* keyword[],int keyLength) {
+    int len = strlen(keyword[keyLength - 1]);
+    if (len == 0 || keyword[keyLength - 1][len - 1] != ';') return INVALID_ESSENTIALS;
+
+    int errors = 0;
+    int i;
+    for (i = 5; i < keyLength; i++) {
+        int wordLength = (i == keyLength - 1) ? len - 1 : (int)strlen(keyword[i]);
+        const char *colon = memchr(keyword[i], ':', wordLength);
+        int nameLength = colon ? (int)(colon - keyword[i]) : wordLength;
+        if (!knownResource(keyword[i], nameLength, 1)) errors |= INVALID_ESSENTIALS;
+        if (colon && parseQuantity(colon + 1, wordLength - nameLength - 1) <= 0) errors |= INVALID_QUANTITY;
+    }
+    return errors;
+}
+
+//Whether one of the items is the number of spaces, space:k
+int hasSpaceQuantity(char* keyword[],int keyLength) {
+    int len = strlen(keyword[keyLength - 1]);
+    int i;
+    for (i = 5; i < keyLength; i++) {
+        int wordLength = (i == keyLength - 1 && len > 0 && keyword[i][len - 1] == ';') ? len - 1 : (int)strlen(keyword[i]);
+        const char *colon = memchr(keyword[i], ':', wordLength);
+        if (colon && catalog_lookup(keyword[i], colon - keyword[i]) == SPACE) return 1;
+    }
+    return 0;
+}
+
+//Whether an item names an essential of the catalog, or a legacy spelling.
+//The space is only an item of addEvent.
+int knownResource(const char *name, int length, int allowSpace) {
+    int r = catalog_lookup(name, length);
+    if (r > SPACE || (r == SPACE && allowSpace)) return 1;
+    int j;
+    for (j = 0; j < (int)(sizeof(legacyEssentials) / sizeof(legacyEssentials[0])); j++) {
+        if ((int)strlen(legacyEssentials[j]) == length && strncmp(legacyEssentials[j], name, length) == 0) return 1;
+    }
+    return 0;
+}
+
+//Value of the digits of a ":count" suffix (1 to 6 of them), -1 if malformed
+int parseQuantity(const char *digits, int length) {
+    int value = 0, i;
+    if (length < 1 || length > 6) return -1;
+    for (i = 0; i < length; i++) {
+        if (digits[i] < '0' || digits[i] > '9') return -1;
+        value = value * 10 + (digits[i] - '0');
+    }
+    return value;
+}
+
+void insertQuantities(Booking *booking, int numOfItems, char *keyword[]) {
+    //Names are read like insertEssentials reads them, with the same bundles,
+    //and a bundle takes the larger count given for any of its essentials
+    booking_request(booking, SPACE, 1);
+
+    int i;
+    for (i = 0; i < numOfItems; i++) {
+        char item[BATCH_SENTENCE_SIZE];
+        snprintf(item, sizeof(item), "%s", keyword[5 + i]);
+        char *colon = strchr(item, ':');
+        int count = 1;
+        if (colon) {
+            *colon = '\0';
+            count = atoi(colon + 1);
+        }
+
+        int r = catalog_lookup(item, strlen(item));
+        if (r == SPACE) {
+            booking->quantity[SPACE] = count;
+        } else if (r > SPACE) {
+            unsigned int bits;
+            booking_request(booking, r, count);
+            for (bits = resource_catalog[r].bundle; bits; bits &= bits - 1) booking_request(booking, __builtin_ctz(bits), count);
+        }
+    }
+}
@@ -1,20 +1,26 @@
 #ifndef NODE_H
 #define NODE_H
 
+#define RESOURCE_NUM 16    //Most resource types a catalog may define
+#ifndef SLOT_MINUTES
+#define SLOT_MINUTES 60     //Length of a time slot, must divide 60 (build with -DSLOT_MINUTES=15 or 5)
+#endif
+#define TESTING_DAY 7      //Days of the testing period, from TEST_START_DATE
+#define TIME_SLOT_PER_DAY (24*60/SLOT_MINUTES)
+
 typedef struct {
-    char member[9];
+    int booking_id;  //Stable id assigned when the booking is stored, 0 if none
+    int member_id;   //id interned by the member registry
+    int site_id;     //id of the car park in the site registry
     char date[11]; // YYYY-MM-DD
     char time[6];  // hh:mm
     float duration;
     int priority;    //4 = event / 3 = reservation / 2 = parking / 1 = essentials
-    int parking_space;
 
-    int battery;
-    int cable;
-    int locker;
-    int umbrella;
-    int valet;
-    int inflation;
+    unsigned int resources;     //Bit r set when resource r of the catalog is booked
+    int quantity[RESOURCE_NUM]; //Units booked of every resource, more than one only for group events
+    int units[RESOURCE_NUM];    //Unit of every resource assigned by the last schedule, -1 if none
+    unsigned int scattered;     //Bit r set when the group units of resource r are not adjacent
 
 } Booking;
 